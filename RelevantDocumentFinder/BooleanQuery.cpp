@@ -0,0 +1,455 @@
+#include "BooleanQuery.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <utility>
+
+
+namespace RelDocFinder
+{
+	namespace
+	{
+		struct Token
+		{
+			enum class Kind : std::uint8_t
+			{
+				word,
+				plus,
+				minus,
+				open,
+				close,
+				conjunction,
+				disjunction,
+				phrase
+			};
+
+			Kind kind;
+			std::string_view text;
+			std::optional<std::uint32_t> slop{};		// phrases followed by ~k
+		};
+
+		// splits on spaces like the document tokenizer, and also around parentheses, quotes and before leading + and -
+		std::vector<Token> tokenize(std::string_view query) noexcept
+		{
+			std::vector<Token> tokens{};
+
+			std::size_t pos{ 0U };
+			while (pos < std::size(query))
+			{
+				const char c{ query[pos] };
+				if (c == ' ')
+				{
+					++pos;
+					continue;
+				}
+
+				// a phrase runs to the next quote, or to the end of the query
+				if (c == '"')
+				{
+					const std::size_t close{ std::min(query.find('"', pos + 1U), std::size(query)) };
+					Token phrase{ Token::Kind::phrase, query.substr(pos + 1U, close - pos - 1U) };
+					pos = std::min(close + 1U, std::size(query));
+
+					if (pos + 1U < std::size(query) && query[pos] == '~' && std::isdigit(static_cast<unsigned char>(query[pos + 1U])))
+					{
+						std::uint32_t slop{ 0U };
+						for (++pos; pos < std::size(query) && std::isdigit(static_cast<unsigned char>(query[pos])); ++pos)
+						{
+							slop = slop * 10U + static_cast<std::uint32_t>(query[pos] - '0');
+						}
+						phrase.slop = slop;
+					}
+
+					tokens.push_back(phrase);
+					continue;
+				}
+
+				if (c == '(' || c == ')')
+				{
+					tokens.emplace_back(c == '(' ? Token::Kind::open : Token::Kind::close, query.substr(pos, 1U), std::nullopt);
+					++pos;
+					continue;
+				}
+
+				// a + or - which starts a token is an operator, unless nothing follows it
+				const bool startsToken{ pos == 0U || query[pos - 1U] == ' ' || query[pos - 1U] == '(' };
+				if ((c == '+' || c == '-') && startsToken && pos + 1U < std::size(query) && query[pos + 1U] != ' ')
+				{
+					tokens.emplace_back(c == '+' ? Token::Kind::plus : Token::Kind::minus, query.substr(pos, 1U), std::nullopt);
+					++pos;
+					continue;
+				}
+
+				const std::size_t end{ std::min(query.find_first_of(" ()\"", pos), std::size(query)) };
+				const std::string_view word{ query.substr(pos, end - pos) };
+				const Token::Kind kind{ word == "AND" ? Token::Kind::conjunction : word == "OR" ? Token::Kind::disjunction : Token::Kind::word };
+				tokens.emplace_back(kind, word, std::nullopt);
+				pos = end;
+			}
+
+			return tokens;
+		}
+	}
+
+	// recursive descent over the tokens, one function per precedence level
+	class BooleanQueryParser
+	{
+	public:
+		using Clause = BooleanQuery::Clause;
+		using Node = BooleanQuery::Node;
+		using Occur = BooleanQuery::Occur;
+
+		explicit BooleanQueryParser(std::vector<Token> tokens, BooleanQuery& query) noexcept : tokens_{ std::move(tokens) }, query_{ query }
+		{
+		}
+
+		// query := clause*
+		Node parseGroup(const bool negated) noexcept
+		{
+			Node group{ Node::Kind::group, {}, {}, {}, {} };
+			while (pos_ < std::size(tokens_) && tokens_[pos_].kind != Token::Kind::close)
+			{
+				if (std::optional<Clause> clause = parseDisjunction(negated))
+				{
+					group.clauses.push_back(std::move(*clause));
+				}
+			}
+			return group;
+		}
+
+		// a ) which closes nothing ends parseGroup early, skipping it lets the outermost group go on
+		[[nodiscard]] bool skipStrayClose() noexcept
+		{
+			return accept(Token::Kind::close);
+		}
+
+	private:
+		std::vector<Token> tokens_;
+		std::size_t pos_{ 0U };
+		BooleanQuery& query_;
+
+
+		void addScoredTerm(std::string_view word, const bool excluded) noexcept
+		{
+			if (!excluded && std::ranges::find(query_.scoredTerms_, word) == query_.scoredTerms_.end())
+			{
+				query_.scoredTerms_.push_back(word);
+			}
+		}
+
+		[[nodiscard]] bool accept(const Token::Kind kind) noexcept
+		{
+			if (pos_ < std::size(tokens_) && tokens_[pos_].kind == kind)
+			{
+				++pos_;
+				return true;
+			}
+			return false;
+		}
+
+		// disjunction := conjunction ( OR conjunction )*
+		std::optional<Clause> parseDisjunction(const bool negated) noexcept
+		{
+			std::optional<Clause> first{ parseConjunction(negated) };
+			if (pos_ >= std::size(tokens_) || tokens_[pos_].kind != Token::Kind::disjunction)
+			{
+				return first;
+			}
+
+			// + means nothing to an alternative, and - makes it match the documents without it
+			Node alternatives{ Node::Kind::group, {}, {}, {}, {} };
+			auto addAlternative = [&alternatives](std::optional<Clause> clause)
+			{
+				if (!clause)
+				{
+					return;
+				}
+
+				if (clause->occur == Occur::mustNot)
+				{
+					Node complement{ Node::Kind::complement, {}, {}, {}, {} };
+					complement.clauses.push_back(Clause{ Occur::should, std::move(clause->node) });
+					alternatives.clauses.push_back(Clause{ Occur::should, std::move(complement) });
+				}
+				else
+				{
+					alternatives.clauses.push_back(Clause{ Occur::should, std::move(clause->node) });
+				}
+			};
+
+			addAlternative(std::move(first));
+			while (accept(Token::Kind::disjunction))
+			{
+				addAlternative(parseConjunction(negated));
+			}
+
+			return Clause{ Occur::should, std::move(alternatives) };
+		}
+
+		// conjunction := unary ( AND unary )*
+		std::optional<Clause> parseConjunction(const bool negated) noexcept
+		{
+			std::optional<Clause> first{ parseUnary(negated) };
+			if (pos_ >= std::size(tokens_) || tokens_[pos_].kind != Token::Kind::conjunction)
+			{
+				return first;
+			}
+
+			Node conjuncts{ Node::Kind::group, {}, {}, {}, {} };
+			auto addConjunct = [&conjuncts](std::optional<Clause> clause)
+			{
+				if (clause)
+				{
+					conjuncts.clauses.push_back(Clause{ clause->occur == Occur::mustNot ? Occur::mustNot : Occur::must, std::move(clause->node) });
+				}
+			};
+
+			addConjunct(std::move(first));
+			while (accept(Token::Kind::conjunction))
+			{
+				addConjunct(parseUnary(negated));
+			}
+
+			return Clause{ Occur::should, std::move(conjuncts) };
+		}
+
+		// unary := ( + | - )? ( word | '(' query ')' )
+		std::optional<Clause> parseUnary(const bool negated) noexcept
+		{
+			Occur occur{ Occur::should };
+			if (accept(Token::Kind::plus))
+			{
+				occur = Occur::must;
+			}
+			else if (accept(Token::Kind::minus))
+			{
+				occur = Occur::mustNot;
+			}
+
+			if (pos_ >= std::size(tokens_))
+			{
+				return { };
+			}
+
+			const Token& token{ tokens_[pos_++] };
+			switch (token.kind)
+			{
+			case Token::Kind::word:
+				addScoredTerm(token.text, negated || occur == Occur::mustNot);
+				return Clause{ occur, Node{ Node::Kind::term, token.text, {}, {}, {} } };
+
+			case Token::Kind::phrase:
+			{
+				Node phrase{ Node::Kind::phrase, token.text, {}, {}, token.slop };
+				for (std::size_t start{ 0U }; start < std::size(token.text); )
+				{
+					const std::size_t end{ std::min(token.text.find(' ', start), std::size(token.text)) };
+					if (end != start)
+					{
+						phrase.words.push_back(token.text.substr(start, end - start));
+						addScoredTerm(phrase.words.back(), negated || occur == Occur::mustNot);
+					}
+					start = end + 1U;
+				}
+				return Clause{ occur, std::move(phrase) };
+			}
+
+			case Token::Kind::open:
+			{
+				Node group{ parseGroup(negated || occur == Occur::mustNot) };
+				static_cast<void>(accept(Token::Kind::close));
+				return Clause{ occur, std::move(group) };
+			}
+
+			default:
+				// a stray ) is skipped by the outermost group, an operator without an operand is dropped
+				if (token.kind == Token::Kind::close)
+				{
+					--pos_;
+				}
+				return { };
+			}
+		}
+	};
+
+	bool BooleanQuery::isBoolean(std::string_view query) noexcept
+	{
+		return std::ranges::any_of(tokenize(query), [](const Token& token) { return token.kind != Token::Kind::word; });
+	}
+
+	BooleanQuery BooleanQuery::parse(std::string_view query) noexcept
+	{
+		BooleanQuery parsed{};
+		BooleanQueryParser parser{ tokenize(query), parsed };
+
+		parsed.root_ = parser.parseGroup(false);
+		while (parser.skipStrayClose())
+		{
+			BooleanQuery::Node rest{ parser.parseGroup(false) };
+			std::ranges::move(rest.clauses, std::back_inserter(parsed.root_.clauses));
+		}
+
+		return parsed;
+	}
+
+	void BooleanQuery::rewriteTerms(const TermRewriter& rewrite) noexcept
+	{
+		BooleanQuery::rewriteTerms(root_, rewrite);
+		for (std::string_view& term : scoredTerms_)
+		{
+			term = rewrite(term);
+		}
+	}
+
+	void BooleanQuery::rewriteTerms(Node& node, const TermRewriter& rewrite) noexcept
+	{
+		if (node.kind == Node::Kind::term)
+		{
+			node.term = rewrite(node.term);
+		}
+
+		for (std::string_view& word : node.words)
+		{
+			word = rewrite(word);
+		}
+
+		for (Clause& clause : node.clauses)
+		{
+			BooleanQuery::rewriteTerms(clause.node, rewrite);
+		}
+	}
+
+	BooleanQuery::Ordinals BooleanQuery::evaluate(const Matchers& matchers) const noexcept
+	{
+		return BooleanQuery::evaluate(root_, matchers, nullptr);
+	}
+
+	std::size_t BooleanQuery::estimate(const Node& node, const Matchers& matchers) noexcept
+	{
+		constexpr std::size_t unbounded{ std::numeric_limits<std::size_t>::max() };
+
+		switch (node.kind)
+		{
+		case Node::Kind::term:
+			return matchers.countTerm(node.term);
+
+		case Node::Kind::phrase:
+		{
+			std::size_t rarest{ node.words.empty() ? 0U : unbounded };
+			for (std::string_view word : node.words)
+			{
+				rarest = std::min(rarest, matchers.countTerm(word));
+			}
+			return rarest;
+		}
+
+		case Node::Kind::complement:
+			return unbounded;
+
+		case Node::Kind::group:
+			break;
+		}
+
+		// the rarest required clause bounds the group, else the sum of the optional ones
+		std::optional<std::size_t> required{};
+		std::size_t optional{ 0U };
+		bool anyShould{ false };
+		for (const Clause& clause : node.clauses)
+		{
+			if (clause.occur == Occur::must)
+			{
+				required = std::min(required.value_or(unbounded), BooleanQuery::estimate(clause.node, matchers));
+			}
+			else if (clause.occur == Occur::should)
+			{
+				const std::size_t clauseEstimate{ BooleanQuery::estimate(clause.node, matchers) };
+				optional = clauseEstimate > unbounded - optional ? unbounded : optional + clauseEstimate;
+				anyShould = true;
+			}
+		}
+
+		return required ? *required : anyShould ? optional : unbounded;
+	}
+
+	BooleanQuery::Ordinals BooleanQuery::evaluate(const Node& node, const Matchers& matchers, const Ordinals* within) noexcept
+	{
+		switch (node.kind)
+		{
+		case Node::Kind::term:
+			return matchers.matchTerm(node.term, within);
+
+		case Node::Kind::phrase:
+			return node.words.empty() ? Ordinals{} : matchers.matchPhrase(node.words, node.slop, within);
+
+		case Node::Kind::complement:
+		{
+			const Ordinals scope{ within ? *within : matchers.matchAll() };
+			const Ordinals excluded{ BooleanQuery::evaluate(node.clauses.front().node, matchers, &scope) };
+
+			Ordinals complement{};
+			std::ranges::set_difference(scope, excluded, std::back_inserter(complement));
+			return complement;
+		}
+
+		case Node::Kind::group:
+			break;
+		}
+
+		// the required clauses narrow the ordinals down from the most selective one on
+		std::vector<std::pair<std::size_t, const Node*>> required{};
+		for (const Clause& clause : node.clauses)
+		{
+			if (clause.occur == Occur::must)
+			{
+				required.emplace_back(BooleanQuery::estimate(clause.node, matchers), &clause.node);
+			}
+		}
+		std::ranges::stable_sort(required, {}, &std::pair<std::size_t, const Node*>::first);
+
+		std::optional<Ordinals> matched{};
+		for (const std::pair<std::size_t, const Node*>& clause : required)
+		{
+			matched = BooleanQuery::evaluate(*clause.second, matchers, matched ? &*matched : within);
+			if (matched->empty())
+			{
+				return { };
+			}
+		}
+
+		// without must clauses one of the should clauses has to match, or anything does if there are none
+		if (!matched)
+		{
+			bool anyShould{ false };
+			Ordinals shouldMatches{};
+			for (const Clause& clause : node.clauses)
+			{
+				if (clause.occur == Occur::should)
+				{
+					const Ordinals clauseMatches{ BooleanQuery::evaluate(clause.node, matchers, within) };
+					Ordinals united{};
+					std::ranges::set_union(shouldMatches, clauseMatches, std::back_inserter(united));
+					shouldMatches = std::move(united);
+					anyShould = true;
+				}
+			}
+			matched = anyShould ? std::move(shouldMatches) : within ? *within : matchers.matchAll();
+		}
+
+		// the excluded clauses are only matched within what is left
+		for (const Clause& clause : node.clauses)
+		{
+			if (clause.occur == Occur::mustNot && !matched->empty())
+			{
+				const Ordinals excluded{ BooleanQuery::evaluate(clause.node, matchers, &*matched) };
+				Ordinals kept{};
+				std::ranges::set_difference(*matched, excluded, std::back_inserter(kept));
+				matched = std::move(kept);
+			}
+		}
+
+		return std::move(*matched);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// a query using the boolean operators, which restrict the documents it ranks to those it matches
+	//
+	//   +word       the document must contain the word
+	//   -word       the document must not contain the word
+	//   a AND b     both match
+	//   a OR b      either matches
+	//   ( ... )     grouping, +, - and juxtaposition apply to groups too
+	//   "a b"       the words next to each other, in order
+	//   "a b"~k     the words in any order, within a window of #(words) + k positions
+	//
+	// AND binds tighter than OR, which binds tighter than juxtaposition
+	// juxtaposed clauses match like Lucene's: every + clause must match and no - clause may,
+	// the plain clauses only add to the score unless there is no + clause, then one of them must match
+	// a query without any operator is not boolean and ranks every document, as it always has
+	class BooleanQuery
+	{
+	public:
+		enum class Occur : std::uint8_t
+		{
+			should,
+			must,
+			mustNot
+		};
+
+		struct Clause;
+
+		struct Node
+		{
+			enum class Kind : std::uint8_t
+			{
+				term,
+				group,			// clauses
+				complement,		// the documents which clauses[0] does not match
+				phrase			// words, slop
+			};
+
+			Kind kind;
+			std::string_view term;
+			std::vector<Clause> clauses;
+			std::vector<std::string_view> words;
+			std::optional<std::uint32_t> slop;		// none for an exact phrase
+		};
+
+		struct Clause
+		{
+			Occur occur;
+			Node node;
+		};
+
+		// ascending ordinals of documents
+		using Ordinals = std::vector<DocOrdinal>;
+
+		// #(documents which contain the word), so the most selective clauses are matched first
+		using TermCounter = std::function<std::size_t(std::string_view word)>;
+
+		// the ordinals of within whose documents contain the word, or of every live document if within is nullptr
+		using TermMatcher = std::function<Ordinals(std::string_view word, const Ordinals* within)>;
+
+		// likewise for the phrase, see Node::slop
+		using PhraseMatcher = std::function<Ordinals(std::span<const std::string_view> words, std::optional<std::uint32_t> slop, const Ordinals* within)>;
+
+		// every live ordinal, only needed by clauses which merely exclude
+		using UniverseMatcher = std::function<Ordinals()>;
+
+		// the word a caller's index holds for a query word, a view which must outlive the query
+		using TermRewriter = std::function<std::string_view(std::string_view word)>;
+
+		struct Matchers
+		{
+			TermCounter countTerm;
+			TermMatcher matchTerm;
+			PhraseMatcher matchPhrase;
+			UniverseMatcher matchAll;
+		};
+
+
+		[[nodiscard]] static bool isBoolean(std::string_view query) noexcept;
+
+		// lenient: a missing ) is implied, a stray ) or an operator without an operand is ignored
+		[[nodiscard]] static BooleanQuery parse(std::string_view query) noexcept;
+
+		// the distinct words which are not excluded, views into the parsed query
+		[[nodiscard]] const std::vector<std::string_view>& scoredTerms() const noexcept { return scoredTerms_; }
+
+		// replaces every word of the query, including scoredTerms, by what rewrite returns for it
+		void rewriteTerms(const TermRewriter& rewrite) noexcept;
+
+		// the ordinals which the query matches
+		// the required clauses are matched from the most selective on, each within the ordinals the previous ones left,
+		// so a rare word spares the postings of a common one all but a galloping intersection
+		[[nodiscard]] Ordinals evaluate(const Matchers& matchers) const noexcept;
+
+	private:
+		Node root_;
+		std::vector<std::string_view> scoredTerms_;
+
+
+		// the ordinals of within which the node matches, of every live document if within is nullptr
+		static Ordinals evaluate(const Node& node, const Matchers& matchers, const Ordinals* within) noexcept;
+
+		static void rewriteTerms(Node& node, const TermRewriter& rewrite) noexcept;
+
+		// an upper bound of #(documents the node matches)
+		static std::size_t estimate(const Node& node, const Matchers& matchers) noexcept;
+
+		friend class BooleanQueryParser;
+	};
+}
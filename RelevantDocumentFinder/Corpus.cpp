@@ -1,243 +1,1059 @@
 #include "Corpus.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <deque>
 #include <ranges>
 #include <mutex>
+#include <thread>
 #include <cmath>
 
 
 namespace RelDocFinder
 {
-	Corpus::DocumentBag Corpus::getDocumentBag(std::string_view doc)
+	Corpus::ParsedQuery Corpus::parseQuery(std::string_view query) noexcept
 	{
-		DocumentBag docBag{};
+		if (!BooleanQuery::isBoolean(query)) [[likely]]
+		{
+			return ParsedQuery{ CorpusShard::getDocumentBag(query), std::nullopt, {} };
+		}
 
-		std::string::size_type start{ 0U };
+		ParsedQuery parsed{ {}, BooleanQuery::parse(query), {} };
+		for (std::string_view term : parsed.filter->scoredTerms())
+		{
+			parsed.bag.emplace(term, 1U);
+		}
+		return parsed;
+	}
 
-		while (start < doc.size())
+	void Corpus::routeFieldTerms(ParsedQuery& parsed) const noexcept
+	{
+		std::unordered_map<std::string_view, std::string_view> routed{};
+		const auto route = [this, &parsed, &routed](std::string_view term) -> std::string_view
 		{
-			const auto end = doc.find_first_of(' ', start);
-			if (start != end)
+			const std::size_t colon{ term.find(':') };
+			if (colon == std::string_view::npos || colon == 0U || colon + 1U == std::size(term)) [[likely]]
+			{
+				return term;
+			}
+
+			if (const auto it = routed.find(term); it != routed.end())
 			{
-				std::string_view wrd{ doc.substr(start, end - start) };
-				++docBag[wrd];
+				return it->second;
 			}
 
-			if (end == std::string_view::npos)
-				break;
+			const std::string_view name{ term.substr(0U, colon) };
+			const bool isField{ std::ranges::any_of(shards_, [name](const std::unique_ptr<CorpusShard>& shard) { return shard->hasField(name); }) };
+			const std::string_view key{ isField ? std::string_view{ parsed.fieldTerms.emplace_back(CorpusShard::fieldTerm(name, term.substr(colon + 1U))) } : term };
+			routed.emplace(term, key);
+			return key;
+		};
 
-			start = end + 1U;
+		DocumentBag bag{};
+		for (const auto& entry : parsed.bag)
+		{
+			bag[route(entry.first)] += entry.second;
 		}
+		parsed.bag = std::move(bag);
 
-		return docBag;
+		if (parsed.filter)
+		{
+			parsed.filter->rewriteTerms(route);
+		}
 	}
 
-	Corpus::Corpus(std::string_view csvFilePath)
+	std::string Corpus::normalizeQuery(std::string_view query, const ParsedQuery& parsed)
 	{
-		std::ifstream csvFile{ csvFilePath.data() };
+		if (parsed.filter)
+		{
+			return std::string{ query };
+		}
 
-		DocId docId{ 0U };
+		const DocumentBag& queryBag{ parsed.bag };
+		std::vector<std::string_view> terms{ std::ranges::begin(std::ranges::views::keys(queryBag)), std::ranges::end(std::ranges::views::keys(queryBag)) };
+		std::ranges::sort(terms);
 
-		for (std::string line{}; std::getline(csvFile, line); )
+		std::string normalizedQuery{};
+		for (std::string_view term : terms)
 		{
-			const auto delimPos{ line.find(',') };
-			std::string_view svDocId{ line.begin(), line.begin() + delimPos };
-			docId = std::strtoul(svDocId.data(), nullptr, 10);
+			normalizedQuery.append(term).push_back(' ');
+		}
 
-			std::string_view svDoc{ line.begin() + delimPos + 1U, line.end() };
-			docIdToDocument_.emplace(docId, svDoc);
+		return normalizedQuery;
+	}
 
-			docIdToDocBag_.emplace(docId, Corpus::getDocumentBag(docIdToDocument_.at(docId)));
+	Corpus::Corpus() : Corpus{ CorpusOptions{} }
+	{
+	}
+
+	Corpus::Corpus(const CorpusOptions& options)
+	{
+		if (options.queryCacheCapacity != 0U)
+		{
+			queryCache_ = std::make_unique<QueryCache>(options.queryCacheCapacity);
+		}
+
+		executorThreads_ = options.executorThreads;
+		purgeDeletedRatio_ = options.purgeDeletedRatio;
+		indexPositions_ = options.indexPositions;
+
+		const std::size_t shardCount{ options.shardCount != 0U ? options.shardCount : std::max(std::thread::hardware_concurrency(), 1U) };
+		shards_.reserve(shardCount);
+		for (std::size_t i{ 0U }; i < shardCount; ++i)
+		{
+			shards_.push_back(std::make_unique<CorpusShard>(statistics_, options.compressPostings, options.postingCacheBytes / shardCount, options.indexPositions,
+				options.documentBlockBytes, options.documentCacheBlocks, options.storeDocuments));
+		}
+	}
 
-			ulong docSize{ 0U };
-			for (const std::pair<std::string_view, Frequency>& entry : docIdToDocBag_.at(docId))
+	Corpus::Corpus(std::string_view csvFilePath, const CorpusOptions& options, const CsvColumns& columns) : Corpus{ options }
+	{
+		std::ifstream csvFile{ std::string{ csvFilePath } };
+		CsvReader reader{ csvFile };
+
+		// reused for every record, the reader hands out views into its own buffer
+		MappedRecord mapped{};
+
+		while (reader.readRecord())
+		{
+			if (!Corpus::mapRecord(reader.fields(), columns, mapped)) [[unlikely]]
 			{
-				docSize += entry.second;
-				const auto it = wordToDocIds_.find(entry.first);
-				if (it != wordToDocIds_.end())
-				{
-					it->second.insert(docId);
-				}
-				else
-				{
-					wordToDocIds_.emplace(entry.first, std::initializer_list<DocId>{ docId });
-				}
+				continue;
 			}
 
-			docIdToSize_.emplace(docId, docSize);
+			shardOf(mapped.docId).insertDocument(mapped.docId, mapped.fields.empty()
+				? CorpusShard::prepareDocument(mapped.text, indexPositions_)
+				: CorpusShard::prepareDocument(mapped.fields, indexPositions_));
 		}
 	}
 
-	std::optional<std::string_view> Corpus::getDocument(const DocId docId) const noexcept
+	bool Corpus::mapRecord(std::span<const std::string_view> record, const CsvColumns& columns, MappedRecord& mapped) noexcept
 	{
-		std::shared_lock lock{ mutex_ };
+		mapped.text = {};
+		mapped.fields.clear();
 
-		if (docIdToDocument_.contains(docId)) [[likely]]
+		// a record without a numeric id is skipped, like one without any text
+		if (columns.idColumn >= std::size(record) || !Corpus::parseDocId(record[columns.idColumn], mapped.docId)) [[unlikely]]
 		{
-			return docIdToDocument_.at(docId);
+			return false;
 		}
-		else [[unlikely]]
+
+		const auto columnText = [&record](const std::size_t column)
 		{
-			return { };
+			return column < std::size(record) ? record[column] : std::string_view{};
+		};
+
+		if (!columns.textColumns.empty()
+			&& std::ranges::none_of(columns.textColumns, [](const CsvTextColumn& column) { return column.field.empty(); }))
+		{
+			for (const CsvTextColumn& column : columns.textColumns)
+			{
+				mapped.fields.emplace_back(column.field, columnText(column.column));
+			}
+			return Corpus::areValidFields(mapped.fields);
 		}
+
+		if (columns.textColumns.empty())
+		{
+			// the reader leaves the commas between fields, so the rest of the record is still one view
+			if (columns.idColumn + 1U < std::size(record))
+			{
+				const std::string_view last{ record.back() };
+				mapped.text = std::string_view{ record[columns.idColumn + 1U].data(), last.data() + std::size(last) };
+			}
+		}
+		else
+		{
+			mapped.joined.clear();
+			for (const CsvTextColumn& column : columns.textColumns)
+			{
+				if (!mapped.joined.empty())
+				{
+					mapped.joined.push_back(' ');
+				}
+				mapped.joined.append(columnText(column.column));
+			}
+			mapped.text = mapped.joined;
+		}
+
+		return !mapped.text.empty();
 	}
 
-	bool Corpus::deleteDocument(const DocId docId) noexcept
+	std::size_t Corpus::ingest(std::istream& input, const IngestOptions& options)
 	{
-		std::unique_lock lock{ mutex_ };
+		if (options.format == IngestFormat::csv)
+		{
+			CsvReader reader{ input };
+			return ingestRecords(reader, std::make_shared<const CsvColumns>(options.columns), options);
+		}
 
-		if (!docIdToDocument_.contains(docId)) [[unlikely]]
+		// the reader returns the id and then the text values in order, so they map like columns
+		CsvColumns columns{ 0U, {} };
+		for (const JsonlTextKey& textKey : options.keys.textKeys)
 		{
-			return false;
+			columns.textColumns.emplace_back(std::size(columns.textColumns) + 1U, textKey.field);
 		}
 
-		for (const std::pair<std::string_view, Frequency>& entry : docIdToDocBag_.at(docId))
+		JsonlReader reader{ input, options.keys };
+		return ingestRecords(reader, std::make_shared<const CsvColumns>(std::move(columns)), options);
+	}
+
+	template <typename RecordReader>
+	std::size_t Corpus::ingestRecords(RecordReader& reader, std::shared_ptr<const CsvColumns> columns, const IngestOptions& options)
+	{
+		const std::size_t batchSize{ std::max<std::size_t>(options.batchSize, 1U) };
+		const std::size_t maxBatchesInFlight{ std::max<std::size_t>(options.maxBatchesInFlight, 1U) };
+
+		MappedRecord mapped{};
+		IngestBatch batch{};
+
+		// batches are committed in the order they were read, so the last record of an id always wins
+		std::deque<std::future<PreparedBatch>> inFlight{};
+		std::size_t committed{ 0U };
+
+		// should reading throw, the batches still tokenizing are waited for before the exception leaves
+		struct DrainGuard
 		{
-			const auto it = wordToDocIds_.find(entry.first);
-			if (it != wordToDocIds_.end())
+			std::deque<std::future<PreparedBatch>>& inFlight;
+
+			~DrainGuard()
 			{
-				it->second.erase(docId);
-				if (it->second.empty())
+				for (const std::future<PreparedBatch>& prepared : inFlight)
 				{
-					wordToDocIds_.erase(it);
+					prepared.wait();
 				}
 			}
+		};
+		const DrainGuard drainGuard{ inFlight };
+
+		const auto dispatch = [&]()
+		{
+			if (batch.records.empty())
+			{
+				return;
+			}
+
+			// backpressure: the reader waits for the oldest batch once enough are tokenizing
+			if (std::size(inFlight) == maxBatchesInFlight)
+			{
+				committed += commitBatch(inFlight.front().get());
+				inFlight.pop_front();
+			}
+
+			inFlight.push_back(prepareBatch(std::move(batch), columns));
+			batch = {};
+		};
+
+		while (reader.readRecord())
+		{
+			if (!Corpus::mapRecord(reader.fields(), *columns, mapped)) [[unlikely]]
+			{
+				continue;
+			}
+
+			// the reader's buffer is reused, so the texts are copied into the batch's
+			const std::size_t firstSpan{ std::size(batch.spans) };
+			if (mapped.fields.empty())
+			{
+				batch.spans.emplace_back(std::size(batch.texts), std::size(mapped.text));
+				batch.texts.append(mapped.text);
+			}
+			for (const DocumentField& field : mapped.fields)
+			{
+				batch.spans.emplace_back(std::size(batch.texts), std::size(field.text));
+				batch.texts.append(field.text);
+			}
+			batch.records.emplace_back(mapped.docId, firstSpan, !mapped.fields.empty());
+
+			if (std::size(batch.records) == batchSize)
+			{
+				dispatch();
+			}
 		}
+		dispatch();
 
-		docIdToDocBag_.erase(docId);
-		docIdToSize_.erase(docId);
-		docIdToDocument_.erase(docId);
+		for (; !inFlight.empty(); inFlight.pop_front())
+		{
+			committed += commitBatch(inFlight.front().get());
+		}
 
-		return true;
+		return committed;
 	}
 
-	bool Corpus::addDocument(const DocId docId, std::string_view doc) noexcept
+	std::future<Corpus::PreparedBatch> Corpus::prepareBatch(IngestBatch batch, std::shared_ptr<const CsvColumns> columns) const noexcept
 	{
-		std::unique_lock lock{ mutex_ };
+		// std::function needs a copyable callable, so the promise and the batch are shared
+		auto promise{ std::make_shared<std::promise<PreparedBatch>>() };
+		std::future<PreparedBatch> prepared{ promise->get_future() };
 
-		if (doc.empty() || docIdToDocument_.contains(docId)) [[unlikely]]
+		executor().post([this, promise, shared = std::make_shared<const IngestBatch>(std::move(batch)), columns = std::move(columns)]()
 		{
-			return false;
-		}
+			const std::string_view texts{ shared->texts };
+			const auto spanText = [&shared, texts](const std::size_t span)
+			{
+				return texts.substr(shared->spans[span].first, shared->spans[span].second);
+			};
 
-		docIdToDocument_.emplace(docId, doc);
+			PreparedBatch documents{};
+			documents.reserve(std::size(shared->records));
+			std::vector<DocumentField> fields{};
+			for (const IngestBatch::Record& record : shared->records)
+			{
+				if (!record.fielded)
+				{
+					documents.emplace_back(record.docId, CorpusShard::prepareDocument(spanText(record.firstSpan), indexPositions_));
+					continue;
+				}
 
-		docIdToDocBag_.emplace(docId, Corpus::getDocumentBag(docIdToDocument_.at(docId)));
+				fields.clear();
+				for (std::size_t i{ 0U }; i < std::size(columns->textColumns); ++i)
+				{
+					fields.emplace_back(columns->textColumns[i].field, spanText(record.firstSpan + i));
+				}
+				documents.emplace_back(record.docId, CorpusShard::prepareDocument(fields, indexPositions_));
+			}
+
+			promise->set_value(std::move(documents));
+		});
+
+		return prepared;
+	}
 
-		ulong docSize{ 0U };
-		for (const std::pair<std::string_view, Frequency>& entry : docIdToDocBag_.at(docId))
+	std::size_t Corpus::commitBatch(PreparedBatch batch) noexcept
+	{
+		std::vector<std::vector<std::size_t>> shardToDocuments(std::size(shards_));
+		for (std::size_t i{ 0U }; i < std::size(batch); ++i)
 		{
-			docSize += entry.second;
-			const auto it = wordToDocIds_.find(entry.first);
-			if (it != wordToDocIds_.end())
+			shardToDocuments[shardIndex(batch[i].first)].push_back(i);
+		}
+
+		// each shard is locked once for the whole batch
+		for (std::size_t shardIdx{ 0U }; shardIdx < std::size(shards_); ++shardIdx)
+		{
+			if (shardToDocuments[shardIdx].empty())
 			{
-				it->second.insert(docId);
+				continue;
 			}
-			else
+
+			CorpusShard& shard{ *shards_[shardIdx] };
+			std::unique_lock lock{ shard.mutex };
+			for (const std::size_t i : shardToDocuments[shardIdx])
 			{
-				wordToDocIds_.emplace(entry.first, std::initializer_list<DocId>{ docId });
+				auto& [docId, prepared] = batch[i];
+				if (shard.contains(docId))
+				{
+					shard.replaceDocument(docId, std::move(prepared));
+				}
+				else
+				{
+					shard.insertDocument(docId, std::move(prepared));
+				}
 			}
+			schedulePurge(shard, lock);
+		}
+
+		if (!batch.empty())
+		{
+			generation_.fetch_add(1U, std::memory_order_release);
+		}
+
+		return std::size(batch);
+	}
+
+	bool Corpus::parseDocId(std::string_view text, DocId& docId) noexcept
+	{
+		const char* const end{ text.data() + std::size(text) };
+		const std::from_chars_result parsed{ std::from_chars(text.data(), end, docId) };
+		return parsed.ec == std::errc{} && parsed.ptr == end;
+	}
+
+	std::size_t Corpus::shardIndex(const DocId docId) const noexcept
+	{
+		return std::hash<DocId>()(docId) % std::size(shards_);
+	}
+
+	CorpusShard& Corpus::shardOf(const DocId docId) const noexcept
+	{
+		return *shards_[shardIndex(docId)];
+	}
+
+	Corpus::SharedLocks Corpus::lockShards() const noexcept
+	{
+		SharedLocks locks{};
+		locks.reserve(std::size(shards_));
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			locks.emplace_back(shard->mutex);
 		}
+		return locks;
+	}
+
+	std::optional<PinnedText> Corpus::getDocument(const DocId docId) const noexcept
+	{
+		const CorpusShard& shard{ shardOf(docId) };
+
+		std::shared_lock lock{ shard.mutex };
+
+		return shard.findDocument(docId);
+	}
+
+	bool Corpus::deleteDocument(const DocId docId) noexcept
+	{
+		CorpusShard& shard{ shardOf(docId) };
+
+		std::unique_lock lock{ shard.mutex };
+
+		if (!shard.eraseDocument(docId)) [[unlikely]]
+		{
+			return false;
+		}
+
+		generation_.fetch_add(1U, std::memory_order_release);
 
-		docIdToSize_.emplace(docId, docSize);
+		schedulePurge(shard, lock);
 
 		return true;
 	}
 
+	void Corpus::schedulePurge(CorpusShard& shard, std::unique_lock<std::shared_mutex>& lock) noexcept
+	{
+		if (!shard.needsPurge(purgeDeletedRatio_) || !shard.schedulePurge())
+		{
+			return;
+		}
+
+		lock.unlock();
+
+		// the executor drains before the shards are destroyed, so the task never outlives its shard
+		executor().post([&shard]()
+		{
+			std::unique_lock purgeLock{ shard.mutex };
+			shard.purgeDeleted();
+		});
+	}
+
+	std::size_t Corpus::purgeDeleted() noexcept
+	{
+		std::size_t purged{ 0U };
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			std::unique_lock lock{ shard->mutex };
+			purged += shard->purgeDeleted();
+		}
+		return purged;
+	}
+
+	bool Corpus::addDocument(const DocId docId, std::string_view doc) noexcept
+	{
+		if (doc.empty()) [[unlikely]]
+		{
+			return false;
+		}
+
+		// tokenize before locking, the lock is only held to update the index
+		return addPrepared(docId, CorpusShard::prepareDocument(doc, indexPositions_));
+	}
+
+	bool Corpus::addDocument(const DocId docId, std::span<const DocumentField> fields) noexcept
+	{
+		if (!Corpus::areValidFields(fields)) [[unlikely]]
+		{
+			return false;
+		}
+
+		return addPrepared(docId, CorpusShard::prepareDocument(fields, indexPositions_));
+	}
+
 	bool Corpus::updateDocument(const DocId docId, std::string_view doc) noexcept
 	{
-		if (deleteDocument(docId)) [[likely]]
+		if (doc.empty()) [[unlikely]]
 		{
-			return addDocument(docId, doc);
+			return false;
 		}
-		else [[unlikely]]
+
+		return updatePrepared(docId, CorpusShard::prepareDocument(doc, indexPositions_));
+	}
+
+	bool Corpus::updateDocument(const DocId docId, std::span<const DocumentField> fields) noexcept
+	{
+		if (!Corpus::areValidFields(fields)) [[unlikely]]
 		{
 			return false;
 		}
+
+		return updatePrepared(docId, CorpusShard::prepareDocument(fields, indexPositions_));
 	}
 
 	bool Corpus::addOrUpdateDocument(const DocId docId, std::string_view doc) noexcept
 	{
-		if (docIdToDocument_.contains(docId))
+		if (doc.empty()) [[unlikely]]
+		{
+			return false;
+		}
+
+		return addOrUpdatePrepared(docId, CorpusShard::prepareDocument(doc, indexPositions_));
+	}
+
+	bool Corpus::addOrUpdateDocument(const DocId docId, std::span<const DocumentField> fields) noexcept
+	{
+		if (!Corpus::areValidFields(fields)) [[unlikely]]
+		{
+			return false;
+		}
+
+		return addOrUpdatePrepared(docId, CorpusShard::prepareDocument(fields, indexPositions_));
+	}
+
+	std::optional<PinnedText> Corpus::getField(const DocId docId, std::string_view name) const noexcept
+	{
+		const CorpusShard& shard{ shardOf(docId) };
+
+		std::shared_lock lock{ shard.mutex };
+
+		const std::optional<std::pair<std::size_t, std::size_t>> extent{ shard.findField(docId, name) };
+		if (!extent)
+		{
+			return { };
+		}
+
+		const std::optional<PinnedText> document{ shard.findDocument(docId) };
+		if (!document)
+		{
+			return { };
+		}
+
+		return document->substr(extent->first, extent->second);
+	}
+
+	bool Corpus::areValidFields(std::span<const DocumentField> fields) noexcept
+	{
+		if (std::ranges::all_of(fields, [](const DocumentField& field) { return field.text.empty(); })) [[unlikely]]
+		{
+			return false;
+		}
+
+		for (auto it = std::ranges::begin(fields); it != std::ranges::end(fields); ++it)
+		{
+			if (it->name.empty() || it->name.find_first_of(": ") != std::string_view::npos
+				|| std::ranges::find(std::ranges::begin(fields), it, it->name, &DocumentField::name) != it)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Corpus::addPrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept
+	{
+		CorpusShard& shard{ shardOf(docId) };
+
+		std::unique_lock lock{ shard.mutex };
+
+		if (!shard.insertDocument(docId, std::move(prepared))) [[unlikely]]
 		{
-			return updateDocument(docId, doc);
+			return false;
+		}
+
+		generation_.fetch_add(1U, std::memory_order_release);
+
+		return true;
+	}
+
+	bool Corpus::updatePrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept
+	{
+		CorpusShard& shard{ shardOf(docId) };
+
+		std::unique_lock lock{ shard.mutex };
+
+		if (!shard.replaceDocument(docId, std::move(prepared))) [[unlikely]]
+		{
+			return false;
+		}
+
+		generation_.fetch_add(1U, std::memory_order_release);
+
+		schedulePurge(shard, lock);
+
+		return true;
+	}
+
+	bool Corpus::addOrUpdatePrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept
+	{
+		CorpusShard& shard{ shardOf(docId) };
+
+		std::unique_lock lock{ shard.mutex };
+
+		if (shard.contains(docId))
+		{
+			shard.replaceDocument(docId, std::move(prepared));
 		}
 		else
 		{
-			return addDocument(docId, doc);
+			shard.insertDocument(docId, std::move(prepared));
 		}
+
+		generation_.fetch_add(1U, std::memory_order_release);
+
+		schedulePurge(shard, lock);
+
+		return true;
+	}
+
+	QueryResult Corpus::searchQuery(std::string_view query, const std::size_t n) const noexcept
+	{
+		return searchQuery(query, n, QueryOptions{});
 	}
 
-	std::unique_ptr<std::string_view[]> Corpus::searchQuery(std::string_view query, const std::size_t n) const noexcept
+	QueryResult Corpus::searchQuery(std::string_view query, const std::size_t n, const QueryOptions& options) const noexcept
 	{
-		std::shared_lock lock{ mutex_ };
+		if (const QueryStatus status = checkQueryOptions(options); status != QueryStatus::complete) [[unlikely]]
+		{
+			QueryResult queryResult{};
+			queryResult.status_ = status;
+			return queryResult;
+		}
 
-		const DocumentBag queryBag{ Corpus::getDocumentBag(query) };
+		ParsedQuery parsed{ Corpus::parseQuery(query) };
 
-		std::priority_queue<DocInfo> minHeap{ searchAndRank(queryBag, n) };
+		const bool reranked{ options.rerankDepth != 0U && options.reranker };
+
+		std::string normalizedQuery{};
+		if (queryCache_ && !reranked)
+		{
+			normalizedQuery = Corpus::normalizeQuery(query, parsed);
+			if (std::optional<QueryResult> cached = queryCache_->find(normalizedQuery, n, generation_.load(std::memory_order_acquire)))
+			{
+				return std::move(*cached);
+			}
+		}
+
+		const SharedLocks locks{ lockShards() };
+		routeFieldTerms(parsed);
+
+		QueryStatus status{ QueryStatus::complete };
+		std::vector<DocInfo> ranked{ searchAndRank(parsed, reranked ? std::max(n, options.rerankDepth) : n, options, status) };
+		if (reranked)
+		{
+			rerank(ranked, parsed.bag, n, options.reranker);
+		}
 
-		std::unique_ptr<std::string_view[]> queryResult{ obtainQueryResult(minHeap, n) };
+		QueryResult queryResult{ obtainQueryResult(ranked) };
+		queryResult.status_ = status;
+
+		if (queryCache_ && !reranked && status == QueryStatus::complete)
+		{
+			// writers are excluded while the locks are held, so the generation matches the result
+			queryCache_->insert(normalizedQuery, n, generation_.load(std::memory_order_relaxed), queryResult);
+		}
 
 		return queryResult;
 	}
-	
-	std::priority_queue<Corpus::DocInfo> Corpus::searchAndRank(const DocumentBag& queryBag, const std::size_t n) const noexcept
+
+	Executor& Corpus::executor() const noexcept
+	{
+		std::call_once(executorStarted_, [this]()
+		{
+			executor_ = std::make_unique<Executor>(executorThreads_ != 0U ? executorThreads_ : std::max(std::thread::hardware_concurrency(), 1U));
+		});
+
+		return *executor_;
+	}
+
+	std::future<QueryResult> Corpus::searchQueryAsync(std::string_view query, const std::size_t n, QueryOptions options) const noexcept
+	{
+		// std::function needs a copyable callable, so the promise is shared
+		auto promise = std::make_shared<std::promise<QueryResult>>();
+		std::future<QueryResult> future{ promise->get_future() };
+
+		searchQueryAsync(query, n, [promise](QueryResult result) { promise->set_value(std::move(result)); }, std::move(options));
+
+		return future;
+	}
+
+	void Corpus::searchQueryAsync(std::string_view query, const std::size_t n, std::function<void(QueryResult)> callback, QueryOptions options) const noexcept
+	{
+		executor().post([this, query = std::string{ query }, n, callback = std::move(callback), options = std::move(options)]()
+		{
+			callback(searchQuery(query, n, options));
+		});
+	}
+
+	SearchAwaitable Corpus::awaitSearchQuery(std::string_view query, const std::size_t n, QueryOptions options) const noexcept
+	{
+		return SearchAwaitable{ *this, query, n, std::move(options) };
+	}
+
+	SearchAwaitable::SearchAwaitable(const Corpus& corpus, std::string_view query, const std::size_t n, QueryOptions options) noexcept
+		: corpus_{ corpus }, query_{ query }, n_{ n }, options_{ std::move(options) }
+	{
+	}
+
+	void SearchAwaitable::await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		corpus_.searchQueryAsync(query_, n_, [this, handle](QueryResult result)
+		{
+			result_ = std::move(result);
+			handle.resume();
+		}, options_);
+	}
+
+	DocumentStoreStats Corpus::documentStoreStats() const noexcept
+	{
+		DocumentStoreStats total{};
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			std::shared_lock lock{ shard->mutex };
+
+			const DocumentStoreStats stats{ shard->documentStoreStats() };
+			total.documentBytes += stats.documentBytes;
+			total.storedBytes += stats.storedBytes;
+			total.blockHits += stats.blockHits;
+			total.blockMisses += stats.blockMisses;
+		}
+		return total;
+	}
+
+	PostingCacheStats Corpus::postingCacheStats() const noexcept
+	{
+		PostingCacheStats stats{};
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			const PostingCacheStats shardStats{ shard->postingCacheStats() };
+			stats.hits += shardStats.hits;
+			stats.misses += shardStats.misses;
+			stats.bytes += shardStats.bytes;
+		}
+		return stats;
+	}
+
+	std::vector<DocInfo> Corpus::searchQueryIds(std::string_view query, const std::size_t n) const noexcept
+	{
+		ParsedQuery parsed{ Corpus::parseQuery(query) };
+
+		const SharedLocks locks{ lockShards() };
+		routeFieldTerms(parsed);
+
+		QueryStatus status{ QueryStatus::complete };
+		return searchAndRank(parsed, n, QueryOptions{}, status);
+	}
+
+	std::vector<std::optional<PinnedText>> Corpus::fetchDocuments(std::span<const DocId> docIds) const noexcept
 	{
-		std::priority_queue<DocInfo> minHeap{};
+		std::vector<std::optional<PinnedText>> docs(std::size(docIds));
 
-		// tf(term, document) = #(occurences of term in document) / #(words in document)
+		std::vector<std::vector<std::size_t>> shardToDocuments(std::size(shards_));
+		for (std::size_t idx{ 0U }; idx < std::size(docIds); ++idx)
+		{
+			shardToDocuments[shardIndex(docIds[idx])].push_back(idx);
+		}
 
+		// each shard is locked once, and only for its own ids
+		for (std::size_t shardIdx{ 0U }; shardIdx < std::size(shards_); ++shardIdx)
+		{
+			if (shardToDocuments[shardIdx].empty())
+			{
+				continue;
+			}
+
+			const CorpusShard& shard{ *shards_[shardIdx] };
+			std::shared_lock lock{ shard.mutex };
+			for (const std::size_t idx : shardToDocuments[shardIdx])
+			{
+				docs[idx] = shard.findDocument(docIds[idx]);
+			}
+		}
+
+		return docs;
+	}
+
+	std::size_t Corpus::documentFrequency(std::string_view word) const noexcept
+	{
+		const SharedLocks locks{ lockShards() };
+		return sumDocumentFrequency(word);
+	}
+
+	std::size_t Corpus::sumDocumentFrequency(std::string_view word) const noexcept
+	{
+		std::size_t documentFrequency{ 0U };
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			documentFrequency += shard->documentFrequency(word);
+		}
+		return documentFrequency;
+	}
+
+	Corpus::WeightedTerm Corpus::weighTerm(std::string_view term, const std::size_t corpusSize) const noexcept
+	{
 		// idf(term, corpus) = log(size(corpus) / #(documents which contain the term))
 
-		// tfidf(term, document, corpus) = tf * idf
+		WeightedTerm weighted{ {}, sumDocumentFrequency(term), 0.0 };
+		if (weighted.documentFrequency == 0U)
+		{
+			return weighted;
+		}
+
+		weighted.shardPostings.reserve(std::size(shards_));
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			weighted.shardPostings.push_back(shard->viewPostings(term));
+		}
+
+		weighted.idf = std::log10(static_cast<double>(corpusSize) / static_cast<double>(weighted.documentFrequency));
+
+		return weighted;
+	}
+
+	std::vector<DocInfo> Corpus::searchAndRank(const ParsedQuery& parsed, const std::size_t n, const QueryOptions& options, QueryStatus& status) const noexcept
+	{
+		const std::size_t size{ statistics_.documentCount() };
+
+		std::vector<WeightedTerm> terms{};
+		terms.reserve(std::size(parsed.bag));
+		for (std::string_view term : std::ranges::views::keys(parsed.bag))
+		{
+			if (WeightedTerm weighted = weighTerm(term, size); weighted.documentFrequency != 0U)
+			{
+				terms.push_back(std::move(weighted));
+			}
+		}
+
+		std::vector<const WeightedTerm*> termPtrs{};
+		termPtrs.reserve(std::size(terms));
+		for (const WeightedTerm& weighted : terms)
+		{
+			termPtrs.push_back(&weighted);
+		}
+
+		// a query which may be stopped early scores its rarest, most telling words first
+		if (isInterruptible(options))
+		{
+			std::ranges::sort(termPtrs, {}, &WeightedTerm::documentFrequency);
+		}
+
+		std::vector<double> accumulators{};
+		return rank(termPtrs, n, accumulators, options, status, parsed.filter ? &*parsed.filter : nullptr);
+	}
+
+	std::vector<DocInfo> Corpus::rank(std::span<const WeightedTerm* const> terms, const std::size_t n, std::vector<double>& accumulators,
+		const QueryOptions& options, QueryStatus& status, const BooleanQuery* filter) const noexcept
+	{
+		std::vector<DocInfo> ranked{};
+		std::vector<CorpusShard::WeightedPostings> shardTerms{};
+		for (std::size_t shardIdx{ 0U }; shardIdx < std::size(shards_); ++shardIdx)
+		{
+			shardTerms.clear();
+			for (const WeightedTerm* weighted : terms)
+			{
+				if (const std::optional<CorpusShard::PostingsView>& postings = weighted->shardPostings[shardIdx])
+				{
+					shardTerms.emplace_back(&*postings, weighted->idf);
+				}
+			}
+
+			const std::vector<DocInfo> shardRanked{ shards_[shardIdx]->rank(shardTerms, n, accumulators, options, status, filter) };
+			ranked.insert(ranked.end(), shardRanked.begin(), shardRanked.end());
+		}
+
+		Corpus::keepBest(ranked, n);
+
+		return ranked;
+	}
+
+	std::vector<QueryResult> Corpus::searchQueries(std::span<const std::string_view> queries, const std::size_t n) const noexcept
+	{
+		std::vector<ParsedQuery> parsedQueries{};
+		parsedQueries.reserve(std::size(queries));
+		for (std::string_view query : queries)
+		{
+			parsedQueries.push_back(Corpus::parseQuery(query));
+		}
 
-		double corpusSize{ static_cast<double>(std::size(docIdToDocument_)) };
+		std::vector<QueryResult> results(std::size(queries));
 
-		for (const auto& docIdToBag : docIdToDocBag_)
+		const SharedLocks locks{ lockShards() };
+		for (ParsedQuery& parsed : parsedQueries)
 		{
-			const DocId docId = docIdToBag.first;
-			const DocumentBag& currDocBag = docIdToBag.second;
-			const double docSize{ static_cast<double>(docIdToSize_.at(docId)) };
+			routeFieldTerms(parsed);
+		}
 
-			double tfidf{ 0.0 };
+		// every distinct word of the batch is looked up, decoded and weighed once, then shared by all its queries
+		const std::size_t size{ statistics_.documentCount() };
+		std::unordered_map<std::string_view, WeightedTerm> batchTerms{};
+		for (const ParsedQuery& parsed : parsedQueries)
+		{
+			for (std::string_view term : std::ranges::views::keys(parsed.bag))
+			{
+				if (!batchTerms.contains(term))
+				{
+					batchTerms.emplace(term, weighTerm(term, size));
+				}
+			}
+		}
 
-			for (std::string_view term : std::ranges::views::keys(queryBag))
+		std::vector<std::vector<const WeightedTerm*>> queryTerms(std::size(queries));
+		for (std::size_t idx{ 0U }; idx < std::size(parsedQueries); ++idx)
+		{
+			for (std::string_view term : std::ranges::views::keys(parsedQueries[idx].bag))
 			{
-				double tf{ 0.0 };
-				if (auto searchTermInCurrDoc = currDocBag.find(term); searchTermInCurrDoc != currDocBag.end())
+				if (const WeightedTerm& weighted = batchTerms.at(term); weighted.documentFrequency != 0U)
 				{
-					tf += searchTermInCurrDoc->second / docSize;
+					queryTerms[idx].push_back(&weighted);
 				}
+			}
+		}
+
+		// plain queries are ranked in groups which read each posting list once, and queries sharing their costliest word share a group
+		// boolean queries only score the documents they match, so they are ranked one by one
+		std::vector<std::size_t> plain{}, filtered{};
+		for (std::size_t idx{ 0U }; idx < std::size(parsedQueries); ++idx)
+		{
+			(parsedQueries[idx].filter ? filtered : plain).push_back(idx);
+		}
+		std::ranges::sort(plain, std::ranges::greater{}, [&queryTerms](const std::size_t idx)
+		{
+			const auto costliest = std::ranges::max_element(queryTerms[idx], {}, &WeightedTerm::documentFrequency);
+			return costliest != queryTerms[idx].end() ? std::pair{ (*costliest)->documentFrequency, *costliest } : std::pair<std::size_t, const WeightedTerm*>{};
+		});
+
+		std::size_t largestShard{ 1U };
+		for (const std::unique_ptr<CorpusShard>& shard : shards_)
+		{
+			largestShard = std::max(largestShard, shard->ordinalCount());
+		}
+		const std::size_t groupSize{ std::clamp<std::size_t>(passAccumulatorBytes / (sizeof(double) * largestShard), 1U, queriesPerPass) };
+		const std::size_t nGroups{ (std::size(plain) + groupSize - 1U) / groupSize };
+		const std::size_t nItems{ nGroups + std::size(filtered) };
 
-				double nDocsWhichContainTerm{ 1 };
-				if (auto searchCorpus = wordToDocIds_.find(term); searchCorpus != wordToDocIds_.end())
+		// the items are then ranked on the executor and the calling thread, each reusing its accumulators;
+		// they only read the index, which our shared locks keep writers away from
+		std::atomic<std::size_t> nextItem{ 0U };
+		const std::function<void()> rankItems = [&]()
+		{
+			std::vector<double> accumulators{};
+			std::vector<std::vector<double>> groupAccumulators{};
+			for (std::size_t item{ nextItem++ }; item < nItems; item = nextItem++)
+			{
+				if (item < nGroups)
 				{
-					nDocsWhichContainTerm = static_cast<double>(std::size(searchCorpus->second));
+					const std::span<const std::size_t> group{ std::span{ plain }.subspan(item * groupSize, std::min(groupSize, std::size(plain) - item * groupSize)) };
+					const std::vector<std::vector<DocInfo>> ranked{ rankTogether(group, queryTerms, n, groupAccumulators) };
+					for (std::size_t q{ 0U }; q < std::size(group); ++q)
+					{
+						results[group[q]] = obtainQueryResult(ranked[q]);
+					}
+					continue;
 				}
 
-				const double idf{ std::log10(corpusSize / nDocsWhichContainTerm) };
+				const std::size_t idx{ filtered[item - nGroups] };
+				QueryStatus status{ QueryStatus::complete };
+				results[idx] = obtainQueryResult(rank(queryTerms[idx], n, accumulators, QueryOptions{}, status, &*parsedQueries[idx].filter));
+			}
+		};
 
-				tfidf += tf * idf;
+		Executor& pool{ executor() };
+		pool.runShared(rankItems, std::min(pool.threadCount(), nItems != 0U ? nItems - 1U : 0U));
+
+		return results;
+	}
+
+	std::vector<std::vector<DocInfo>> Corpus::rankTogether(std::span<const std::size_t> group, std::span<const std::vector<const WeightedTerm*>> queryTerms,
+		const std::size_t n, std::vector<std::vector<double>>& accumulators) const noexcept
+	{
+		std::vector<std::vector<DocInfo>> ranked(std::size(group));
+		std::vector<CorpusShard::SharedPostings> shardTerms{};
+		for (std::size_t shardIdx{ 0U }; shardIdx < std::size(shards_); ++shardIdx)
+		{
+			// the group's words in this shard, each with the queries holding it
+			shardTerms.clear();
+			for (std::size_t q{ 0U }; q < std::size(group); ++q)
+			{
+				for (const WeightedTerm* weighted : queryTerms[group[q]])
+				{
+					if (const std::optional<CorpusShard::PostingsView>& postings = weighted->shardPostings[shardIdx])
+					{
+						auto shared = std::ranges::find(shardTerms, &*postings, &CorpusShard::SharedPostings::postings);
+						if (shared == shardTerms.end())
+						{
+							shared = shardTerms.insert(shardTerms.end(), CorpusShard::SharedPostings{ &*postings, weighted->idf, {} });
+						}
+						shared->queries.push_back(q);
+					}
+				}
 			}
 
-			minHeap.emplace(docId, tfidf);
-			if (minHeap.size() == n + 1U)
+			const std::vector<std::vector<DocInfo>> shardRanked{ shards_[shardIdx]->rankShared(shardTerms, std::size(group), n, accumulators) };
+			for (std::size_t q{ 0U }; q < std::size(group); ++q)
 			{
-				minHeap.pop();
+				ranked[q].insert(ranked[q].end(), shardRanked[q].begin(), shardRanked[q].end());
 			}
 		}
 
-		return minHeap;
+		for (std::vector<DocInfo>& queryRanked : ranked)
+		{
+			Corpus::keepBest(queryRanked, n);
+		}
+
+		return ranked;
+	}
+
+	void Corpus::rerank(std::vector<DocInfo>& ranked, const DocumentBag& queryBag, const std::size_t n, const Reranker& reranker) const noexcept
+	{
+		std::vector<RerankCandidate> candidates{};
+		candidates.reserve(std::size(ranked));
+		for (const DocInfo& docInfo : ranked)
+		{
+			candidates.emplace_back(docInfo.docId, docInfo.tfIdfScore, shardOf(docInfo.docId).documentLength(docInfo.docId));
+		}
+
+		// the texts the re-ranker asked for, pinned until it returns
+		std::vector<std::optional<PinnedText>> texts{};
+
+		const std::vector<std::string_view> words{ std::ranges::begin(std::ranges::views::keys(queryBag)), std::ranges::end(std::ranges::views::keys(queryBag)) };
+		const RerankContext context{ words, [this, &words](const DocId docId)
+		{
+			return shardOf(docId).proximityWindow(docId, words);
+		}, [this, &texts](const DocId docId)
+		{
+			texts.push_back(shardOf(docId).findDocument(docId));
+			return texts.back() ? texts.back()->view() : std::string_view{};
+		} };
+
+		reranker(candidates, context);
+
+		for (std::size_t idx{ 0U }; idx < std::size(ranked); ++idx)
+		{
+			ranked[idx].tfIdfScore = candidates[idx].score;
+		}
+
+		Corpus::keepBest(ranked, n);
 	}
 
-	std::unique_ptr<std::string_view[]> Corpus::obtainQueryResult(std::priority_queue<DocInfo>& minHeap, const std::size_t n) const noexcept
+	void Corpus::keepBest(std::vector<DocInfo>& ranked, const std::size_t n) noexcept
 	{
-		std::unique_ptr<std::string_view[]> queryResult = std::make_unique<std::string_view[]>(n);
-		std::size_t idx{ minHeap.size() - 1U };
-		while (!minHeap.empty())
+		// highest score first, ties broken by the lower DocId, like within a shard
+		const auto better = [](const DocInfo lhs, const DocInfo rhs)
 		{
-			queryResult[idx] = docIdToDocument_.at(minHeap.top().docId);
-			--idx;
-			minHeap.pop();
+			return lhs.tfIdfScore != rhs.tfIdfScore ? lhs.tfIdfScore > rhs.tfIdfScore : lhs.docId < rhs.docId;
+		};
+
+		const std::size_t nRanked{ std::min(n, std::size(ranked)) };
+		std::ranges::partial_sort(ranked, ranked.begin() + nRanked, better);
+		ranked.resize(nRanked);
+	}
+
+	QueryResult Corpus::obtainQueryResult(const std::vector<DocInfo>& ranked) const noexcept
+	{
+		QueryResult queryResult{};
+		queryResult.hits_.reserve(std::size(ranked));
+		queryResult.pinnedDocuments_.reserve(std::size(ranked));
+		for (const DocInfo& docInfo : ranked)
+		{
+			std::optional<PinnedText> doc{ shardOf(docInfo.docId).findDocument(docInfo.docId) };
+			queryResult.hits_.emplace_back(docInfo.docId, docInfo.tfIdfScore, doc ? doc->view() : std::string_view{});
+			if (doc)
+			{
+				queryResult.pinnedDocuments_.push_back(std::move(*doc));
+			}
 		}
 		return queryResult;
 	}
@@ -1,51 +1,104 @@
+#include <atomic>
+#include <coroutine>
+#include <deque>
 #include <fstream>
 #include <string>
 #include <numeric>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
-#include <initializer_list>
-#include <queue>
 #include <optional>
 #include <functional>
+#include <istream>
+#include <future>
+#include <mutex>
 #include <shared_mutex>
+#include <span>
+#include <vector>
+
+#include "BooleanQuery.hpp"
+#include "CorpusShard.hpp"
+#include "CorpusStatistics.hpp"
+#include "CorpusTypes.hpp"
+#include "CsvReader.hpp"
+#include "Executor.hpp"
+#include "JsonlReader.hpp"
+#include "PostingCache.hpp"
+#include "QueryCache.hpp"
+#include "QueryOptions.hpp"
+#include "QueryResult.hpp"
 
 
 namespace RelDocFinder
 {
-	using ulong = unsigned long;
-	using DocId = ulong;
+	struct CorpusOptions
+	{
+		std::size_t queryCacheCapacity{ 0U };		// #(query results to cache), 0 disables the cache
+		bool compressPostings{ false };				// keep posting lists varint encoded, decode them when searching
+		std::size_t postingCacheBytes{ 0U };		// bytes of decoded posting lists to cache, 0 disables the cache
+		std::size_t executorThreads{ 0U };			// threads running asynchronous queries, 0 for one per core
+		std::size_t shardCount{ 0U };				// independently locked partitions of the documents, 0 for one per core
+		double purgeDeletedRatio{ 0.25 };			// share of a shard's ordinals deleted before its postings are purged in the background
+		bool indexPositions{ false };				// keep word positions for exact phrase and proximity queries, at a memory cost
+		std::size_t documentBlockBytes{ 0U };		// compress the documents' texts in blocks of about this many bytes, 0 keeps them as they are
+		std::size_t documentCacheBlocks{ 8U };		// decompressed blocks of texts to cache per shard
+		bool storeDocuments{ true };				// keep the documents' texts, without them only ids and scores are found
+	};
 
-	struct string_view_hash
+	enum class IngestFormat
 	{
-		using is_transparent = std::true_type;
+		csv,
+		jsonl
+	};
 
-		auto operator()(std::string_view sv) const noexcept
-		{
-			return std::hash<std::string_view>()(sv);
-		}
+	struct IngestOptions
+	{
+		IngestFormat format{ IngestFormat::csv };
+		CsvColumns columns{};						// for csv
+		JsonlKeys keys{};							// for jsonl
+		std::size_t batchSize{ 1024U };				// documents committed under one lock of each shard
+		std::size_t maxBatchesInFlight{ 4U };		// batches read ahead of the commits, which bounds the memory held
 	};
 
-	struct string_view_equal
+
+	class Corpus;
+
+	// co_await-ing it runs the query on the corpus' executor and resumes the coroutine on that executor's thread
+	class SearchAwaitable
 	{
-		using is_transparent = std::true_type;
+	public:
+		SearchAwaitable(const Corpus& corpus, std::string_view query, const std::size_t n, QueryOptions options) noexcept;
 
-		bool operator()(std::string_view a, std::string_view b) const noexcept
-		{
-			return a == b;
-		}
+		[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+		[[nodiscard]] QueryResult await_resume() noexcept { return std::move(result_); }
+
+	private:
+		const Corpus& corpus_;
+		std::string query_;
+		std::size_t n_;
+		QueryOptions options_;
+		QueryResult result_;
 	};
 
 
 	class Corpus
 	{
 	public:
-		explicit Corpus() = default;
+		explicit Corpus();
+
+		explicit Corpus(const CorpusOptions& options);
 
-		explicit Corpus(std::string_view csvFilePath);  // init with csv file, each line is considered as a document
+		// init with an RFC 4180 csv file, each record is considered as a document
+		// records without a numeric id or without text are skipped, as are ids already loaded
+		explicit Corpus(std::string_view csvFilePath, const CorpusOptions& options = {}, const CsvColumns& columns = {});
 
-		[[nodiscard]] std::optional<std::string_view> getDocument(const DocId docId) const noexcept;
+		// the text stays valid for as long as the returned PinnedText is kept
+		// always none for a corpus which does not store documents
+		[[nodiscard]] std::optional<PinnedText> getDocument(const DocId docId) const noexcept;
 
+		// the document is gone at once, its postings are purged in the background once enough of its shard is deleted
 		[[nodiscard]] bool deleteDocument(const DocId docId) noexcept;
 
 		[[nodiscard]] bool addDocument(const DocId docId, std::string_view doc) noexcept;
@@ -54,51 +107,201 @@ namespace RelDocFinder
 
 		[[nodiscard]] bool addOrUpdateDocument(const DocId docId, std::string_view doc) noexcept;
 
-		[[nodiscard]] std::unique_ptr<std::string_view[]> searchQuery(std::string_view query, const std::size_t n) const noexcept;
+		// a document of named fields, searched as a whole by plain words and field by field by name:word
+		// once any document had a field of the name, a query's name:word searches only that field and never a plain word of a text
+		// names must be distinct, non-empty and hold neither ':' nor ' ', and at least one field must have text
+		// getDocument returns the fields' texts joined by spaces
+		[[nodiscard]] bool addDocument(const DocId docId, std::span<const DocumentField> fields) noexcept;
 
-	private:
-		using Frequency = ulong;
+		[[nodiscard]] bool updateDocument(const DocId docId, std::span<const DocumentField> fields) noexcept;
+
+		[[nodiscard]] bool addOrUpdateDocument(const DocId docId, std::span<const DocumentField> fields) noexcept;
 
-		// word to document-IDs which it appears in
-		// the functors are so unordered_map could look up both std::string and std::string_view
-		// as std::string_view can be implicitly constructed from std::string
-		using WordToDocIds = std::unordered_map<std::string, std::unordered_set<DocId>, string_view_hash, string_view_equal>;
+		[[nodiscard]] std::optional<PinnedText> getField(const DocId docId, std::string_view name) const noexcept;
 
-		// word to its frequency in a document
-		using DocumentBag = std::unordered_map<std::string_view, Frequency>;
+		// streams csv or jsonl records from input, such as a pipe, tokenizing batches of them on the executor
+		// records are mapped like the csv constructor's, but a record of an existing id updates it
+		// returns #(documents added or updated), it must not be called from a task of the corpus' executor
+		std::size_t ingest(std::istream& input, const IngestOptions& options = {});
 
-		// document id to its document bag
-		using DocIdToDocumentBag = std::unordered_map<DocId, DocumentBag>;
+		// a query with +, -, AND, OR or parentheses ranks only the documents it matches, see BooleanQuery
+		[[nodiscard]] QueryResult searchQuery(std::string_view query, const std::size_t n) const noexcept;
 
-		using DocIdToDocument = std::unordered_map<DocId, std::string>;
+		// a query stopped by its deadline or stop token returns the best hits found so far, see QueryResult::isPartial
+		[[nodiscard]] QueryResult searchQuery(std::string_view query, const std::size_t n, const QueryOptions& options) const noexcept;
 
+		// ranks like searchQuery but returns only ids and scores, without touching the stored documents
+		[[nodiscard]] std::vector<DocInfo> searchQueryIds(std::string_view query, const std::size_t n) const noexcept;
 
-		struct DocInfo
+		// runs searchQuery on the corpus' executor, so the calling thread never blocks
+		[[nodiscard]] std::future<QueryResult> searchQueryAsync(std::string_view query, const std::size_t n, QueryOptions options = {}) const noexcept;
+
+		void searchQueryAsync(std::string_view query, const std::size_t n, std::function<void(QueryResult)> callback, QueryOptions options = {}) const noexcept;
+
+		[[nodiscard]] SearchAwaitable awaitSearchQuery(std::string_view query, const std::size_t n, QueryOptions options = {}) const noexcept;
+
+		// ranks a batch of queries, looking up and decoding each posting list once for the whole batch
+		[[nodiscard]] std::vector<QueryResult> searchQueries(std::span<const std::string_view> queries, const std::size_t n) const noexcept;
+
+		// the documents of docIds, locking each shard once, none for the ids which are not in the corpus
+		// or for every id if the corpus does not store documents
+		[[nodiscard]] std::vector<std::optional<PinnedText>> fetchDocuments(std::span<const DocId> docIds) const noexcept;
+
+		[[nodiscard]] PostingCacheStats postingCacheStats() const noexcept;
+
+		[[nodiscard]] DocumentStoreStats documentStoreStats() const noexcept;
+
+		// purges the postings of every deleted document now, returns #(documents purged)
+		std::size_t purgeDeleted() noexcept;
+
+		// document count and lengths, kept up to date by every write
+		[[nodiscard]] const CorpusStatistics& statistics() const noexcept { return statistics_; }
+
+		// #(documents which contain the word), summed over the shards, which keep it next to their postings
+		[[nodiscard]] std::size_t documentFrequency(std::string_view word) const noexcept;
+
+	private:
+		using DocumentBag = CorpusShard::DocumentBag;
+
+		// a query word's postings in every shard, weighted by its corpus-wide idf
+		struct WeightedTerm
+		{
+			std::vector<std::optional<CorpusShard::PostingsView>> shardPostings;
+			std::size_t documentFrequency;
+			double idf;
+		};
+
+		using SharedLocks = std::vector<std::shared_lock<std::shared_mutex>>;
+
+		// a csv record mapped to a document, reused from record to record
+		struct MappedRecord
 		{
-			DocId docId;
-			double tfIdfScore;
+			DocId docId{ 0U };
+			std::string_view text;						// the plain document, empty for a document of fields
+			std::vector<DocumentField> fields;
+			std::string joined;							// backs text when several plain columns were joined
+		};
 
-			// sizeof(DocInfo) is small, so take by value
-			friend bool operator<(const DocInfo lhs, const DocInfo rhs) 
+		// the texts of records read for ingest, copied into one buffer
+		struct IngestBatch
+		{
+			struct Record
 			{
-				return lhs.tfIdfScore > rhs.tfIdfScore;
-			}
+				DocId docId;
+				std::size_t firstSpan;					// the plain text, or the first of the text columns
+				bool fielded;
+			};
+
+			std::string texts;
+			std::vector<std::pair<std::size_t, std::size_t>> spans;		// offset and length in texts
+			std::vector<Record> records;
 		};
 
+		using PreparedBatch = std::vector<std::pair<DocId, CorpusShard::PreparedDocument>>;
+
+		// the words to score a query by, and for a boolean query the filter of the documents it matches
+		struct ParsedQuery
+		{
+			DocumentBag bag;							// views into the query, or into fieldTerms once routed
+			std::optional<BooleanQuery> filter;
+			std::deque<std::string> fieldTerms;			// see routeFieldTerms
+		};
+
+		// a batch ranks its plain queries in groups of at most this many, each group reading a posting list once
+		static constexpr std::size_t queriesPerPass{ 16U };
+
+		// and of few enough queries that their accumulators, an array per query, stay within this many bytes
+		static constexpr std::size_t passAccumulatorBytes{ 64U * 1024U * 1024U };
+
+
+		// shared by the shards, declared before them so it outlives them
+		CorpusStatistics statistics_;
+
+		// documents are spread over independently locked shards by DocId, so writes to different shards run in parallel
+		std::vector<std::unique_ptr<CorpusShard>> shards_;
+
+		// bumped by every write, so cached query results of an older corpus are never served
+		std::atomic<std::uint64_t> generation_{ 0U };
+		std::unique_ptr<QueryCache> queryCache_;
+
+		double purgeDeletedRatio_{ 0.25 };
+		bool indexPositions_{ false };
+
+		// started by the first asynchronous query, declared last so it drains before the index is destroyed
+		std::size_t executorThreads_{ 0U };
+		mutable std::once_flag executorStarted_;
+		mutable std::unique_ptr<Executor> executor_;
+
+
+		static ParsedQuery parseQuery(std::string_view query) noexcept;
+
+		// the whole text must be the number
+		static bool parseDocId(std::string_view text, DocId& docId) noexcept;
+
+		static bool areValidFields(std::span<const DocumentField> fields) noexcept;
+
+		// false for a record to skip, the views of mapped are valid as long as record's
+		static bool mapRecord(std::span<const std::string_view> record, const CsvColumns& columns, MappedRecord& mapped) noexcept;
+
+		// the sorted distinct terms of a query, which is all searchAndRank depends on
+		// boolean queries are keyed by their text, which always holds an operator and so never equals a plain query's key
+		static std::string normalizeQuery(std::string_view query, const ParsedQuery& parsed);
+
+
+		std::size_t shardIndex(const DocId docId) const noexcept;
+
+		CorpusShard& shardOf(const DocId docId) const noexcept;
+
+		// a consistent snapshot for reading the whole corpus, the shards are always locked in the same order
+		SharedLocks lockShards() const noexcept;
+
+		Executor& executor() const noexcept;
+
+		// posts a purge of the shard to the executor once it has work, releasing lock, the shard's exclusive lock, first
+		void schedulePurge(CorpusShard& shard, std::unique_lock<std::shared_mutex>& lock) noexcept;
+
+		bool addPrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept;
+
+		bool updatePrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept;
+
+		bool addOrUpdatePrepared(const DocId docId, CorpusShard::PreparedDocument prepared) noexcept;
+
+		// reads, batches and commits the records of a CsvReader or JsonlReader, mapped by columns
+		template <typename RecordReader>
+		std::size_t ingestRecords(RecordReader& reader, std::shared_ptr<const CsvColumns> columns, const IngestOptions& options);
+
+		// tokenizes the batch on the executor, whose task shares the columns
+		std::future<PreparedBatch> prepareBatch(IngestBatch batch, std::shared_ptr<const CsvColumns> columns) const noexcept;
+
+		// returns #(documents committed)
+		std::size_t commitBatch(PreparedBatch batch) noexcept;
+
+		// callers must hold lockShards()
+		// turns each name:word of the query into its field term, see CorpusShard::fieldTerm, unless no document ever had a field of the name
+		void routeFieldTerms(ParsedQuery& parsed) const noexcept;
+
+		// callers must hold lockShards()
+		std::vector<DocInfo> searchAndRank(const ParsedQuery& parsed, const std::size_t n, const QueryOptions& options, QueryStatus& status) const noexcept;
 
-		WordToDocIds wordToDocIds_;							// stores strings
-		DocIdToDocumentBag docIdToDocBag_;					// stores string_views
-		std::unordered_map<DocId, ulong> docIdToSize_;
-		DocIdToDocument docIdToDocument_;					// stores strings
+		// callers must hold lockShards()
+		std::size_t sumDocumentFrequency(std::string_view word) const noexcept;
 
-		mutable std::shared_mutex mutex_;
+		WeightedTerm weighTerm(std::string_view term, const std::size_t corpusSize) const noexcept;
 
+		// ranks every shard and merges their top n, accumulators is scratch space for callers ranking many queries
+		std::vector<DocInfo> rank(std::span<const WeightedTerm* const> terms, const std::size_t n, std::vector<double>& accumulators,
+			const QueryOptions& options, QueryStatus& status, const BooleanQuery* filter = nullptr) const noexcept;
 
-		static DocumentBag getDocumentBag(std::string_view doc);
+		// ranks a group of plain queries of a batch, each shard reading a posting list once for all of them, see CorpusShard::rankShared
+		std::vector<std::vector<DocInfo>> rankTogether(std::span<const std::size_t> group, std::span<const std::vector<const WeightedTerm*>> queryTerms,
+			const std::size_t n, std::vector<std::vector<double>>& accumulators) const noexcept;
 
+		// sorts the n best to the front and drops the rest
+		static void keepBest(std::vector<DocInfo>& ranked, const std::size_t n) noexcept;
 
-		std::priority_queue<DocInfo> searchAndRank(const DocumentBag& queryBag, const std::size_t n) const noexcept;
+		// callers must hold lockShards(), keeps the n best after re-ranking
+		void rerank(std::vector<DocInfo>& ranked, const DocumentBag& queryBag, const std::size_t n, const Reranker& reranker) const noexcept;
 
-		std::unique_ptr<std::string_view[]> obtainQueryResult(std::priority_queue<DocInfo>& minHeap, const std::size_t n) const noexcept;
+		QueryResult obtainQueryResult(const std::vector<DocInfo>& ranked) const noexcept;
 	};
 }
\ No newline at end of file
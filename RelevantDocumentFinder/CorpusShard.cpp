@@ -0,0 +1,1096 @@
+#include "CorpusShard.hpp"
+#include "PostingIntersection.hpp"
+#include "Varint.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <limits>
+#include <ranges>
+
+
+namespace RelDocFinder
+{
+	namespace
+	{
+		// positions[wordIndex[i]] holds start + i for some start
+		[[nodiscard]] bool isPhrase(const std::vector<std::vector<std::uint32_t>>& positions, std::span<const std::size_t> wordIndex) noexcept
+		{
+			for (const std::uint32_t start : positions[wordIndex.front()])
+			{
+				bool found{ true };
+				for (std::size_t i{ 1U }; i < std::size(wordIndex) && found; ++i)
+				{
+					found = std::ranges::binary_search(positions[wordIndex[i]], start + static_cast<std::uint32_t>(i));
+				}
+
+				if (found)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// the fewest consecutive positions holding counts[w] distinct positions of every word w, searching stops once it is at most enough
+		[[nodiscard]] std::uint32_t minimalWindow(const std::vector<std::vector<std::uint32_t>>& positions, std::span<const std::size_t> counts,
+			const std::size_t enough) noexcept
+		{
+			// every position of the words in order, tagged with its word
+			std::vector<std::pair<std::uint32_t, std::size_t>> merged{};
+			for (std::size_t w{ 0U }; w < std::size(positions); ++w)
+			{
+				for (const std::uint32_t position : positions[w])
+				{
+					merged.emplace_back(position, w);
+				}
+			}
+			std::ranges::sort(merged);
+
+			// slides the window's end along, shrinking it from the start while it still holds enough of every word
+			std::uint32_t best{ std::numeric_limits<std::uint32_t>::max() };
+			std::vector<std::size_t> held(std::size(positions), 0U);
+			std::size_t missing{ std::size(positions) };
+			for (std::size_t first{ 0U }, last{ 0U }; last < std::size(merged); ++last)
+			{
+				if (++held[merged[last].second] == counts[merged[last].second])
+				{
+					--missing;
+				}
+
+				for (; missing == 0U; ++first)
+				{
+					best = std::min(best, merged[last].first - merged[first].first + 1U);
+					if (best <= enough)
+					{
+						return best;
+					}
+
+					if (held[merged[first].second]-- == counts[merged[first].second])
+					{
+						++missing;
+					}
+				}
+			}
+			return best;
+		}
+
+		// a posting list's ordinals a block at a time, a roaring list's read from its bitmap rather than decoded up front
+		class OrdinalBlocks
+		{
+		public:
+			explicit OrdinalBlocks(const CorpusShard::PostingsView& postings) noexcept : ordinals_{ postings.ordinals }
+			{
+				if (postings.roaring)
+				{
+					reader_.emplace(*postings.roaring);
+				}
+			}
+
+			// the next at most count ordinals, empty once all were read
+			[[nodiscard]] std::span<const DocOrdinal> next(const std::size_t count) noexcept
+			{
+				if (!reader_) [[likely]]
+				{
+					const std::span<const DocOrdinal> block{ ordinals_.first(std::min(count, std::size(ordinals_))) };
+					ordinals_ = ordinals_.subspan(std::size(block));
+					return block;
+				}
+
+				block_.clear();
+				reader_->read(block_, count);
+				return block_;
+			}
+
+		private:
+			std::span<const DocOrdinal> ordinals_;
+			std::optional<RoaringBitmap::Reader> reader_;
+			std::vector<DocOrdinal> block_;
+		};
+
+		// like PostingIntersection::intersect, a block of candidates at a time with the postings they span,
+		// and stopping with the matches so far once the checker says the query is stopped
+		void intersectChecked(std::span<const DocOrdinal> candidates, std::span<const DocOrdinal> ordinals, const std::size_t blockSize,
+			QueryChecker& checker, std::vector<PostingIntersection::Match>& matches) noexcept
+		{
+			std::vector<PostingIntersection::Match> blockMatches{};
+			std::size_t begin{ 0U };			// the ordinals before it are below the candidates still to intersect
+			for (std::size_t first{ 0U }; first < std::size(candidates) && begin < std::size(ordinals); first += blockSize)
+			{
+				const std::span<const DocOrdinal> block{ candidates.subspan(first, std::min(blockSize, std::size(candidates) - first)) };
+				const std::size_t last{ static_cast<std::size_t>(std::ranges::upper_bound(ordinals.subspan(begin), block.back()) - ordinals.begin()) };
+				if (checker.stopped(std::size(block) + last - begin))
+				{
+					return;
+				}
+
+				blockMatches.clear();
+				PostingIntersection::intersect(block, ordinals.subspan(begin, last - begin), blockMatches);
+				for (const PostingIntersection::Match match : blockMatches)
+				{
+					matches.emplace_back(static_cast<std::uint32_t>(match.lhs + first), static_cast<std::uint32_t>(match.rhs + begin));
+				}
+				begin = last;
+			}
+		}
+
+		// like PostingIntersection::intersect with a roaring list on the right, rhs being the rank of the posting
+		// a few candidates are looked up in the bitmap, many are merged with it block by block
+		void intersectRoaring(std::span<const DocOrdinal> candidates, const CorpusShard::PostingsView& postings, const std::size_t blockSize,
+			QueryChecker* checker, std::vector<PostingIntersection::Match>& matches) noexcept
+		{
+			const RoaringBitmap& roaring{ *postings.roaring };
+			if (std::size(candidates) * PostingIntersection::gallopingRatio <= roaring.cardinality())
+			{
+				for (std::size_t i{ 0U }; i < std::size(candidates); ++i)
+				{
+					if (checker && checker->stopped(1U))
+					{
+						return;
+					}
+
+					if (roaring.contains(candidates[i]))
+					{
+						matches.emplace_back(static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(roaring.rank(candidates[i])));
+					}
+				}
+				return;
+			}
+
+			OrdinalBlocks blocks{ postings };
+			std::vector<PostingIntersection::Match> blockMatches{};
+			std::size_t first{ 0U };			// the candidates before it are below the blocks still to read
+			std::size_t begin{ 0U };
+			for (std::span<const DocOrdinal> block{ blocks.next(blockSize) }; !block.empty() && first < std::size(candidates); block = blocks.next(blockSize))
+			{
+				if (checker && checker->stopped(std::size(block)))
+				{
+					return;
+				}
+
+				const std::size_t last{ static_cast<std::size_t>(std::ranges::upper_bound(candidates.subspan(first), block.back()) - candidates.begin()) };
+
+				blockMatches.clear();
+				PostingIntersection::intersect(candidates.subspan(first, last - first), block, blockMatches);
+				for (const PostingIntersection::Match match : blockMatches)
+				{
+					matches.emplace_back(static_cast<std::uint32_t>(match.lhs + first), static_cast<std::uint32_t>(match.rhs + begin));
+				}
+
+				first = last;
+				begin += std::size(block);
+			}
+		}
+	}
+
+	CorpusShard::DocumentBag CorpusShard::getDocumentBag(std::string_view doc)
+	{
+		DocumentBag docBag{};
+
+		std::string::size_type start{ 0U };
+
+		while (start < doc.size())
+		{
+			const auto end = doc.find_first_of(' ', start);
+			if (start != end)
+			{
+				std::string_view wrd{ doc.substr(start, end - start) };
+				++docBag[wrd];
+			}
+
+			if (end == std::string_view::npos)
+				break;
+
+			start = end + 1U;
+		}
+
+		return docBag;
+	}
+
+	CorpusShard::WordPositions CorpusShard::getWordPositions(std::string_view doc)
+	{
+		// positions count the words like getDocumentBag splits them
+		std::vector<std::pair<std::string_view, std::uint32_t>> occurrences{};
+
+		std::uint32_t position{ 0U };
+		std::string::size_type start{ 0U };
+
+		while (start < doc.size())
+		{
+			const auto end = doc.find_first_of(' ', start);
+			if (start != end)
+			{
+				occurrences.emplace_back(doc.substr(start, end - start), position++);
+			}
+
+			if (end == std::string_view::npos)
+				break;
+
+			start = end + 1U;
+		}
+
+		// grouped by word, each word's positions stay ascending
+		std::ranges::stable_sort(occurrences, {}, &std::pair<std::string_view, std::uint32_t>::first);
+
+		WordPositions positions{};
+		for (std::size_t i{ 0U }; i < std::size(occurrences); ++i)
+		{
+			if (i == 0U || occurrences[i].first != occurrences[i - 1U].first)
+			{
+				positions.words.emplace_back(occurrences[i].first, static_cast<std::uint32_t>(std::size(positions.stream)));
+				Varint::put(positions.stream, occurrences[i].second);
+			}
+			else
+			{
+				Varint::put(positions.stream, occurrences[i].second - occurrences[i - 1U].second);
+			}
+		}
+
+		// kept for the document's lifetime
+		positions.words.shrink_to_fit();
+		positions.stream.shrink_to_fit();
+		return positions;
+	}
+
+	CorpusShard::PreparedDocument CorpusShard::prepareDocument(std::string_view doc, const bool withPositions)
+	{
+		PreparedDocument prepared{ std::make_shared<const std::string>(doc), {}, {} };
+		prepared.bag = CorpusShard::getDocumentBag(*prepared.text);
+		if (withPositions)
+		{
+			prepared.positions = CorpusShard::getWordPositions(*prepared.text);
+		}
+		return prepared;
+	}
+
+	CorpusShard::PreparedDocument CorpusShard::prepareDocument(std::span<const DocumentField> fields, const bool withPositions)
+	{
+		std::unique_ptr<DocumentFields> documentFields{ std::make_unique<DocumentFields>() };
+		std::string text{};
+
+		// the bag can only view into terms once it stops growing, so the terms are noted as offsets first
+		struct Term
+		{
+			std::size_t offset;
+			std::size_t length;
+			Frequency frequency;
+		};
+		std::vector<Term> terms{};
+
+		for (const DocumentField& field : fields)
+		{
+			if (!documentFields->extents.empty())
+			{
+				text.push_back(' ');
+			}
+
+			const DocumentBag fieldBag{ CorpusShard::getDocumentBag(field.text) };
+			documentFields->extents.emplace_back(std::string{ field.name }, std::size(text), std::size(field.text), CorpusShard::documentSize(fieldBag));
+			text.append(field.text);
+
+			for (const auto& entry : fieldBag)
+			{
+				const std::string term{ CorpusShard::fieldTerm(field.name, entry.first) };
+				terms.emplace_back(std::size(documentFields->terms), std::size(term), entry.second);
+				documentFields->terms.append(term);
+			}
+		}
+
+		for (const Term& term : terms)
+		{
+			documentFields->bag[std::string_view{ documentFields->terms }.substr(term.offset, term.length)] += term.frequency;
+		}
+
+		PreparedDocument prepared{ CorpusShard::prepareDocument(text, withPositions) };
+		prepared.fields = std::move(documentFields);
+		return prepared;
+	}
+
+	CorpusShard::CorpusShard(CorpusStatistics& statistics, const bool compressPostings, const std::size_t postingCacheBytes, const bool indexPositions,
+		const std::size_t documentBlockBytes, const std::size_t documentCacheBlocks, const bool storeDocuments)
+		: documentStore_{ documentBlockBytes, documentCacheBlocks }, storeDocuments_{ storeDocuments }, statistics_{ statistics }, compressPostings_{ compressPostings }, indexPositions_{ indexPositions }
+	{
+		if (postingCacheBytes != 0U)
+		{
+			postingCache_ = std::make_unique<PostingCache>(postingCacheBytes);
+		}
+	}
+
+	std::optional<PinnedText> CorpusShard::findDocument(const DocId docId) const noexcept
+	{
+		return documentStore_.find(docId);
+	}
+
+	std::optional<std::pair<std::size_t, std::size_t>> CorpusShard::findField(const DocId docId, std::string_view name) const noexcept
+	{
+		const auto it = docIdToFields_.find(docId);
+		if (it == docIdToFields_.end())
+		{
+			return { };
+		}
+
+		for (const FieldExtent& extent : it->second->extents)
+		{
+			if (extent.name == name)
+			{
+				return std::pair{ extent.offset, extent.length };
+			}
+		}
+		return { };
+	}
+
+	std::size_t CorpusShard::documentLength(const DocId docId) const noexcept
+	{
+		const auto it = docIdToDocBag_.find(docId);
+		return it != docIdToDocBag_.end() ? CorpusShard::documentSize(it->second) : 0U;
+	}
+
+	bool CorpusShard::insertDocument(const DocId docId, PreparedDocument doc) noexcept
+	{
+		if (contains(docId)) [[unlikely]]
+		{
+			return false;
+		}
+
+		const DocOrdinal ordinal{ acquireOrdinal(docId) };
+
+		// the bag is rebuilt on the dictionary's words, so it no longer needs the text
+		DocumentBag docBag{};
+		docBag.reserve(std::size(doc.bag));
+		for (const auto& entry : doc.bag)
+		{
+			docBag.emplace(addPosting(entry.first, ordinal, entry.second), entry.second);
+		}
+
+		if (indexPositions_)
+		{
+			ordinalToPositions_.resize(std::max<std::size_t>(std::size(ordinalToPositions_), ordinal + 1U));
+			ordinalToPositions_[ordinal] = CorpusShard::internPositions(std::move(doc.positions), docBag);
+		}
+
+		const ulong docSize{ CorpusShard::documentSize(docBag) };
+		ordinalToInverseSize_[ordinal] = docSize != 0U ? 1.0 / static_cast<double>(docSize) : 0.0;
+		statistics_.addDocument(docSize);
+
+		if (doc.fields)
+		{
+			DocumentBag fieldBag{};
+			fieldBag.reserve(std::size(doc.fields->bag));
+			for (const auto& entry : doc.fields->bag)
+			{
+				fieldBag.emplace(addPosting(entry.first, ordinal, entry.second), entry.second);
+			}
+			doc.fields->bag = std::move(fieldBag);
+			doc.fields->terms = {};
+
+			setFieldNorms(*doc.fields, ordinal, docSize);
+			docIdToFields_.emplace(docId, std::move(doc.fields));
+		}
+
+		docIdToDocBag_.emplace(docId, std::move(docBag));
+		if (storeDocuments_)
+		{
+			documentStore_.insert(docId, std::move(doc.text));
+		}
+
+		return true;
+	}
+
+	bool CorpusShard::eraseDocument(const DocId docId) noexcept
+	{
+		if (!contains(docId)) [[unlikely]]
+		{
+			return false;
+		}
+
+		const DocOrdinal ordinal{ docIdToOrdinal_.at(docId) };
+
+		// the postings are left to purgeDeleted, only the statistics and document frequencies forget the document now
+		const DocumentBag& docBag{ docIdToDocBag_.at(docId) };
+		for (std::string_view word : std::ranges::views::keys(docBag))
+		{
+			--wordToPostings_.find(word)->second.documentFrequency;
+		}
+
+		statistics_.removeDocument(CorpusShard::documentSize(docBag));
+
+		if (const auto fieldsIt = docIdToFields_.find(docId); fieldsIt != docIdToFields_.end())
+		{
+			for (std::string_view term : std::ranges::views::keys(fieldsIt->second->bag))
+			{
+				--wordToPostings_.find(term)->second.documentFrequency;
+			}
+			setFieldNorms(*fieldsIt->second, ordinal, 0U);
+			docIdToFields_.erase(fieldsIt);
+		}
+
+		if (indexPositions_)
+		{
+			ordinalToPositions_[ordinal] = {};
+		}
+
+		retireOrdinal(ordinal);
+		docIdToDocBag_.erase(docId);
+		documentStore_.erase(docId);
+
+		return true;
+	}
+
+	bool CorpusShard::replaceDocument(const DocId docId, PreparedDocument doc) noexcept
+	{
+		const auto oldBagIt = docIdToDocBag_.find(docId);
+		if (oldBagIt == docIdToDocBag_.end()) [[unlikely]]
+		{
+			return false;
+		}
+
+		// the document keeps its ordinal, and the old and new bags are diffed word by word
+		const DocOrdinal ordinal{ docIdToOrdinal_.at(docId) };
+		const ulong oldDocSize{ CorpusShard::documentSize(oldBagIt->second) };
+		DocumentBag docBag{ diffPostings(oldBagIt->second, doc.bag, ordinal) };
+
+		const ulong docSize{ CorpusShard::documentSize(docBag) };
+		ordinalToInverseSize_[ordinal] = docSize != 0U ? 1.0 / static_cast<double>(docSize) : 0.0;
+		statistics_.resizeDocument(oldDocSize, docSize);
+
+		const auto oldFieldsIt = docIdToFields_.find(docId);
+		const DocumentFields noFields{};
+		const DocumentFields& oldFields{ oldFieldsIt != docIdToFields_.end() ? *oldFieldsIt->second : noFields };
+		DocumentBag fieldBag{ diffPostings(oldFields.bag, doc.fields ? doc.fields->bag : noFields.bag, ordinal) };
+		setFieldNorms(oldFields, ordinal, 0U);
+		if (doc.fields)
+		{
+			doc.fields->bag = std::move(fieldBag);
+			doc.fields->terms = {};
+
+			setFieldNorms(*doc.fields, ordinal, docSize);
+			docIdToFields_.insert_or_assign(docId, std::move(doc.fields));
+		}
+		else if (oldFieldsIt != docIdToFields_.end())
+		{
+			docIdToFields_.erase(oldFieldsIt);
+		}
+
+		if (indexPositions_)
+		{
+			ordinalToPositions_[ordinal] = CorpusShard::internPositions(std::move(doc.positions), docBag);
+		}
+		oldBagIt->second = std::move(docBag);
+		if (storeDocuments_)
+		{
+			documentStore_.insert(docId, std::move(doc.text));
+		}
+
+		return true;
+	}
+
+	std::string_view CorpusShard::addPosting(std::string_view word, const DocOrdinal ordinal, const Frequency frequency) noexcept
+	{
+		auto it = wordToPostings_.find(word);
+		if (it == wordToPostings_.end())
+		{
+			it = wordToPostings_.emplace(word, WordPostings{ PostingList{ compressPostings_ } }).first;
+		}
+
+		it->second.postings.insert(ordinal, frequency);
+		++it->second.documentFrequency;
+
+		if (postingCache_)
+		{
+			postingCache_->erase(word);
+		}
+
+		return it->first;
+	}
+
+	void CorpusShard::removePosting(std::string_view word, const DocOrdinal ordinal) noexcept
+	{
+		const auto it = wordToPostings_.find(word);
+		if (it == wordToPostings_.end())
+		{
+			return;
+		}
+
+		if (!it->second.postings.erase(ordinal)) [[unlikely]]
+		{
+			return;
+		}
+
+		--it->second.documentFrequency;
+
+		if (postingCache_)
+		{
+			postingCache_->erase(word);
+		}
+
+		if (it->second.postings.empty())
+		{
+			wordToPostings_.erase(it);
+		}
+	}
+
+	CorpusShard::DocumentBag CorpusShard::diffPostings(const DocumentBag& oldBag, const DocumentBag& newBag, const DocOrdinal ordinal) noexcept
+	{
+		DocumentBag interned{};
+		interned.reserve(std::size(newBag));
+
+		for (const auto& entry : newBag)
+		{
+			const auto oldEntry = oldBag.find(entry.first);
+			if (oldEntry == oldBag.end())
+			{
+				interned.emplace(addPosting(entry.first, ordinal, entry.second), entry.second);
+				continue;
+			}
+
+			if (oldEntry->second != entry.second)
+			{
+				wordToPostings_.find(entry.first)->second.postings.setFrequency(ordinal, entry.second);
+				if (postingCache_)
+				{
+					postingCache_->erase(entry.first);
+				}
+			}
+			interned.emplace(oldEntry->first, entry.second);
+		}
+
+		// removing a posting may drop the word the old bag views, so the old bag is not looked into after this
+		for (std::string_view word : std::ranges::views::keys(oldBag))
+		{
+			if (!interned.contains(word))
+			{
+				removePosting(word, ordinal);
+			}
+		}
+
+		return interned;
+	}
+
+	CorpusShard::WordPositions CorpusShard::internPositions(WordPositions positions, const DocumentBag& interned) noexcept
+	{
+		// the same words, so they stay in order
+		for (std::pair<std::string_view, std::uint32_t>& word : positions.words)
+		{
+			word.first = interned.find(word.first)->first;
+		}
+		return positions;
+	}
+
+	std::string CorpusShard::fieldTerm(std::string_view name, std::string_view word)
+	{
+		std::string term{};
+		term.reserve(std::size(name) + 1U + std::size(word));
+		term.append(name).append(" ").append(word);
+		return term;
+	}
+
+	std::span<const double> CorpusShard::fieldNorms(std::string_view word) const noexcept
+	{
+		const std::size_t space{ word.find(' ') };
+		if (space == std::string_view::npos)
+		{
+			return { };
+		}
+
+		const auto it = fieldToNorms_.find(word.substr(0U, space));
+		return it != fieldToNorms_.end() ? std::span<const double>{ it->second } : std::span<const double>{};
+	}
+
+	void CorpusShard::setFieldNorms(const DocumentFields& fields, const DocOrdinal ordinal, const ulong docSize) noexcept
+	{
+		for (const FieldExtent& extent : fields.extents)
+		{
+			auto it = fieldToNorms_.find(extent.name);
+			if (it == fieldToNorms_.end())
+			{
+				it = fieldToNorms_.emplace(extent.name, std::vector<double>(std::size(ordinalToDocId_), 0.0)).first;
+			}
+
+			it->second[ordinal] = extent.words != 0U ? static_cast<double>(docSize) / static_cast<double>(extent.words) : 0.0;
+		}
+	}
+
+	ulong CorpusShard::documentSize(const DocumentBag& bag) noexcept
+	{
+		ulong docSize{ 0U };
+		for (const Frequency frequency : std::ranges::views::values(bag))
+		{
+			docSize += frequency;
+		}
+		return docSize;
+	}
+
+	DocOrdinal CorpusShard::acquireOrdinal(const DocId docId) noexcept
+	{
+		DocOrdinal ordinal{ static_cast<DocOrdinal>(std::size(ordinalToDocId_)) };
+		if (!freeOrdinals_.empty())
+		{
+			ordinal = freeOrdinals_.back();
+			freeOrdinals_.pop_back();
+			ordinalToDocId_[ordinal] = docId;
+		}
+		else
+		{
+			ordinalToDocId_.push_back(docId);
+			ordinalToInverseSize_.push_back(0.0);
+			for (std::vector<double>& norms : std::ranges::views::values(fieldToNorms_))
+			{
+				norms.push_back(0.0);
+			}
+			if (ordinal % 64U == 0U)
+			{
+				liveOrdinals_.push_back(0U);
+			}
+		}
+
+		liveOrdinals_[ordinal / 64U] |= std::uint64_t{ 1U } << (ordinal % 64U);
+		docIdToOrdinal_.emplace(docId, ordinal);
+
+		return ordinal;
+	}
+
+	void CorpusShard::retireOrdinal(const DocOrdinal ordinal) noexcept
+	{
+		docIdToOrdinal_.erase(ordinalToDocId_[ordinal]);
+		liveOrdinals_[ordinal / 64U] &= ~(std::uint64_t{ 1U } << (ordinal % 64U));
+		ordinalToInverseSize_[ordinal] = 0.0;
+		deadOrdinals_.push_back(ordinal);
+	}
+
+	bool CorpusShard::needsPurge(const double deletedRatio) const noexcept
+	{
+		return (deletedCount() != 0U && static_cast<double>(deletedCount()) >= deletedRatio * static_cast<double>(ordinalCount()))
+			|| documentStore_.compactableBlocks() != 0U;
+	}
+
+	std::size_t CorpusShard::purgeDeleted() noexcept
+	{
+		purgeScheduled_ = false;
+
+		documentStore_.compact();
+
+		if (deadOrdinals_.empty())
+		{
+			return 0U;
+		}
+
+		for (auto it = wordToPostings_.begin(); it != wordToPostings_.end(); )
+		{
+			if (it->second.postings.retainLive(liveOrdinals_) == 0U)
+			{
+				++it;
+				continue;
+			}
+
+			if (postingCache_)
+			{
+				postingCache_->erase(it->first);
+			}
+
+			it = it->second.postings.empty() ? wordToPostings_.erase(it) : std::next(it);
+		}
+
+		// only now that no posting refers to them can the dead ordinals be reused
+		const std::size_t purged{ std::size(deadOrdinals_) };
+		freeOrdinals_.insert(freeOrdinals_.end(), deadOrdinals_.begin(), deadOrdinals_.end());
+		deadOrdinals_.clear();
+
+		return purged;
+	}
+
+	std::size_t CorpusShard::documentFrequency(std::string_view word) const noexcept
+	{
+		const auto it = wordToPostings_.find(word);
+		return it != wordToPostings_.end() ? it->second.documentFrequency : 0U;
+	}
+
+	std::optional<CorpusShard::PostingsView> CorpusShard::viewPostings(std::string_view word) const noexcept
+	{
+		const auto it = wordToPostings_.find(word);
+		if (it == wordToPostings_.end())
+		{
+			return { };
+		}
+
+		const PostingList& postings{ it->second.postings };
+		if (postings.isFlat()) [[likely]]
+		{
+			return PostingsView{ postings.ordinals(), postings.frequencies(), nullptr, fieldNorms(word) };
+		}
+
+		if (postings.isRoaring())
+		{
+			return PostingsView{ {}, postings.frequencies(), nullptr, fieldNorms(word), &postings.roaring() };
+		}
+
+		PostingCache::DecodedPtr decoded{ postingCache_ ? postingCache_->find(word) : nullptr };
+		if (!decoded)
+		{
+			decoded = std::make_shared<const PostingList::Decoded>(postings.decode());
+			if (postingCache_)
+			{
+				postingCache_->insert(word, decoded);
+			}
+		}
+
+		return PostingsView{ decoded->ordinals, decoded->frequencies, decoded, fieldNorms(word) };
+	}
+
+	std::vector<DocOrdinal> CorpusShard::matchTerm(std::string_view word, const std::vector<DocOrdinal>* within, QueryChecker* checker) const noexcept
+	{
+		std::vector<DocOrdinal> matched{};
+		const std::optional<PostingsView> postings{ viewPostings(word) };
+		if (!postings)
+		{
+			return matched;
+		}
+
+		if (within)
+		{
+			// the intersection gallops through the longer side when the sizes are skewed
+			if (!postings->roaring && !checker) [[likely]]
+			{
+				PostingIntersection::intersect(*within, postings->ordinals, matched);
+			}
+			else if (!postings->roaring)
+			{
+				std::vector<PostingIntersection::Match> matches{};
+				intersectChecked(*within, postings->ordinals, postingBlockSize, *checker, matches);
+				for (const PostingIntersection::Match match : matches)
+				{
+					matched.push_back((*within)[match.lhs]);
+				}
+			}
+			else
+			{
+				for (const DocOrdinal ordinal : *within)
+				{
+					if (checker && checker->stopped(1U))
+					{
+						break;
+					}
+
+					if (postings->roaring->contains(ordinal))
+					{
+						matched.push_back(ordinal);
+					}
+				}
+			}
+			return matched;
+		}
+
+		// the postings of dead ordinals stay until they are purged
+		matched.reserve(postings->size());
+		OrdinalBlocks blocks{ *postings };
+		for (std::span<const DocOrdinal> block{ blocks.next(postingBlockSize) }; !block.empty(); block = blocks.next(postingBlockSize))
+		{
+			if (checker && checker->stopped(std::size(block)))
+			{
+				break;
+			}
+
+			std::ranges::copy_if(block, std::back_inserter(matched), [this](const DocOrdinal ordinal) { return isLive(ordinal); });
+		}
+		return matched;
+	}
+
+	std::vector<DocOrdinal> CorpusShard::matchPhrase(std::span<const std::string_view> words, std::optional<std::uint32_t> slop,
+		const std::vector<DocOrdinal>* within, QueryChecker* checker) const noexcept
+	{
+		std::vector<std::string_view> byFrequency{ words.begin(), words.end() };
+		std::ranges::sort(byFrequency, {}, [this](std::string_view word) { return documentFrequency(word); });
+
+		std::vector<DocOrdinal> candidates{ matchTerm(byFrequency.front(), within, checker) };
+		for (std::size_t i{ 1U }; i < std::size(byFrequency) && !candidates.empty(); ++i)
+		{
+			candidates = matchTerm(byFrequency[i], &candidates, checker);
+		}
+
+		if (!indexPositions_ || std::size(words) < 2U)
+		{
+			return candidates;
+		}
+
+		// a word repeated in the phrase needs as many distinct positions
+		std::vector<std::string_view> distinct{};
+		std::vector<std::size_t> counts{};
+		std::vector<std::size_t> wordIndex{};
+		for (std::string_view word : words)
+		{
+			const auto it = std::ranges::find(distinct, word);
+			wordIndex.push_back(static_cast<std::size_t>(it - distinct.begin()));
+			if (it == distinct.end())
+			{
+				distinct.push_back(word);
+				counts.push_back(0U);
+			}
+			++counts[wordIndex.back()];
+		}
+
+		std::vector<DocOrdinal> matched{};
+		std::vector<std::vector<std::uint32_t>> positions(std::size(distinct));
+		for (const DocOrdinal ordinal : candidates)
+		{
+			if (checker && checker->stopped(std::size(distinct)))
+			{
+				break;
+			}
+
+			for (std::size_t i{ 0U }; i < std::size(distinct); ++i)
+			{
+				positions[i] = positionsOf(ordinal, distinct[i]);
+			}
+
+			if (slop ? minimalWindow(positions, counts, std::size(words) + *slop) <= std::size(words) + *slop : isPhrase(positions, wordIndex))
+			{
+				matched.push_back(ordinal);
+			}
+		}
+
+		return matched;
+	}
+
+	std::optional<ProximityWindow> CorpusShard::proximityWindow(const DocId docId, std::span<const std::string_view> words) const noexcept
+	{
+		const auto it = docIdToOrdinal_.find(docId);
+		if (!indexPositions_ || it == docIdToOrdinal_.end())
+		{
+			return { };
+		}
+
+		std::vector<std::vector<std::uint32_t>> positions{};
+		for (std::string_view word : words)
+		{
+			if (std::vector<std::uint32_t> wordPositions = positionsOf(it->second, word); !wordPositions.empty())
+			{
+				positions.push_back(std::move(wordPositions));
+			}
+		}
+
+		if (std::size(positions) < 2U)
+		{
+			return { };
+		}
+
+		const std::vector<std::size_t> counts(std::size(positions), 1U);
+		return ProximityWindow{ std::size(positions), minimalWindow(positions, counts, std::size(positions)) };
+	}
+
+	std::vector<std::uint32_t> CorpusShard::positionsOf(const DocOrdinal ordinal, std::string_view word) const noexcept
+	{
+		std::vector<std::uint32_t> positions{};
+
+		const WordPositions& wordPositions{ ordinalToPositions_[ordinal] };
+		const auto it = std::ranges::lower_bound(wordPositions.words, word, {}, &std::pair<std::string_view, std::uint32_t>::first);
+		if (it == wordPositions.words.end() || it->first != word)
+		{
+			return positions;
+		}
+
+		// a word's positions run to the next word's
+		const std::uint8_t* in{ wordPositions.stream.data() + it->second };
+		const std::uint8_t* const end{ wordPositions.stream.data() + (std::next(it) != wordPositions.words.end() ? std::next(it)->second : std::size(wordPositions.stream)) };
+		for (std::uint32_t position{ 0U }; in != end; )
+		{
+			position += Varint::get(in);
+			positions.push_back(position);
+		}
+		return positions;
+	}
+
+	std::vector<DocInfo> CorpusShard::rank(std::span<const WeightedPostings> terms, const std::size_t n, std::vector<double>& accumulators,
+		const QueryOptions& options, QueryStatus& status, const BooleanQuery* filter) const noexcept
+	{
+		if (filter)
+		{
+			// a query stopped while matching has nothing accumulated yet
+			QueryChecker checker{ options, status, postingBlockSize };
+			const std::vector<DocOrdinal> candidates{ matchOrdinals(*filter, isInterruptible(options) ? &checker : nullptr) };
+			return status == QueryStatus::complete ? rankCandidates(terms, candidates, n, accumulators, options, status) : std::vector<DocInfo>{};
+		}
+
+		// tf(term, document) = #(occurences of term in document) / #(words in document)
+
+		// tfidf(term, document, corpus) = tf * idf
+
+		// scoring is term-at-a-time: every posting adds #(occurences) * idf to its document's accumulator,
+		// and the shared 1 / #(words in document) factor of tf is applied once, by the top-n scan
+		// a field term is scored by the field's length instead, its norms rescale it to #(words in document)
+
+		accumulators.assign(std::size(ordinalToDocId_), 0.0);
+
+		// an interruptible query checks its deadline and stop token every block of postings,
+		// once stopped it ranks whatever it has accumulated so far
+		const bool interruptible{ isInterruptible(options) };
+
+		for (const WeightedPostings& weighted : terms)
+		{
+			const PostingsView& postings{ *weighted.postings };
+
+			// a flat list of an uninterruptible query is accumulated in one go, a roaring list is always read block by block
+			const std::size_t blockSize{ interruptible || postings.roaring ? postingBlockSize : postings.size() };
+			OrdinalBlocks blocks{ postings };
+			for (std::size_t begin{ 0U }; ; )
+			{
+				const std::span<const DocOrdinal> block{ blocks.next(blockSize) };
+				if (block.empty() || (interruptible && (status = checkQueryOptions(options)) != QueryStatus::complete))
+				{
+					break;
+				}
+
+				const std::span<const Frequency> frequencies{ postings.frequencies.subspan(begin, std::size(block)) };
+				if (postings.norms.empty()) [[likely]]
+				{
+					ScoreKernels::accumulate(accumulators, block, frequencies, weighted.idf);
+				}
+				else
+				{
+					ScoreKernels::accumulate(accumulators, block, frequencies, weighted.idf, postings.norms);
+				}
+				begin += std::size(block);
+			}
+
+			if (status != QueryStatus::complete)
+			{
+				break;
+			}
+		}
+
+		return toDocInfos(ScoreKernels::selectTopN(accumulators, ordinalToInverseSize_, liveOrdinals_, ordinalToDocId_, n));
+	}
+
+	std::vector<std::vector<DocInfo>> CorpusShard::rankShared(std::span<const SharedPostings> terms, const std::size_t nQueries, const std::size_t n,
+		std::vector<std::vector<double>>& accumulators) const noexcept
+	{
+		// scored like rank, only a list is read once for all of its queries rather than once for each
+		if (std::size(accumulators) < nQueries)
+		{
+			accumulators.resize(nQueries);
+		}
+		for (std::size_t q{ 0U }; q < nQueries; ++q)
+		{
+			accumulators[q].assign(std::size(ordinalToDocId_), 0.0);
+		}
+
+		for (const SharedPostings& shared : terms)
+		{
+			const PostingsView& postings{ *shared.postings };
+			OrdinalBlocks blocks{ postings };
+			std::size_t begin{ 0U };
+			for (std::span<const DocOrdinal> block{ blocks.next(postingBlockSize) }; !block.empty(); block = blocks.next(postingBlockSize))
+			{
+				const std::span<const Frequency> frequencies{ postings.frequencies.subspan(begin, std::size(block)) };
+				for (const std::size_t q : shared.queries)
+				{
+					if (postings.norms.empty()) [[likely]]
+					{
+						ScoreKernels::accumulate(accumulators[q], block, frequencies, shared.idf);
+					}
+					else
+					{
+						ScoreKernels::accumulate(accumulators[q], block, frequencies, shared.idf, postings.norms);
+					}
+				}
+				begin += std::size(block);
+			}
+		}
+
+		std::vector<std::vector<DocInfo>> ranked(nQueries);
+		for (std::size_t q{ 0U }; q < nQueries; ++q)
+		{
+			ranked[q] = toDocInfos(ScoreKernels::selectTopN(accumulators[q], ordinalToInverseSize_, liveOrdinals_, ordinalToDocId_, n));
+		}
+		return ranked;
+	}
+
+	std::vector<DocOrdinal> CorpusShard::matchOrdinals(const BooleanQuery& filter, QueryChecker* checker) const noexcept
+	{
+		return filter.evaluate(BooleanQuery::Matchers{
+			[this](std::string_view word) { return documentFrequency(word); },
+			[this, checker](std::string_view word, const std::vector<DocOrdinal>* within) { return matchTerm(word, within, checker); },
+			[this, checker](std::span<const std::string_view> words, std::optional<std::uint32_t> slop, const std::vector<DocOrdinal>* within)
+			{
+				return matchPhrase(words, slop, within, checker);
+			},
+			[this]() { return listLiveOrdinals(); } });
+	}
+
+	std::vector<DocOrdinal> CorpusShard::listLiveOrdinals() const noexcept
+	{
+		std::vector<DocOrdinal> live{};
+		live.reserve(size());
+		for (std::size_t w{ 0U }; w < std::size(liveOrdinals_); ++w)
+		{
+			for (std::uint64_t word{ liveOrdinals_[w] }; word != 0U; word &= word - 1U)
+			{
+				live.push_back(static_cast<DocOrdinal>(w * 64U + static_cast<std::size_t>(std::countr_zero(word))));
+			}
+		}
+		return live;
+	}
+
+	std::vector<DocInfo> CorpusShard::rankCandidates(std::span<const WeightedPostings> terms, std::span<const DocOrdinal> candidates, const std::size_t n,
+		std::vector<double>& accumulators, const QueryOptions& options, QueryStatus& status) const noexcept
+	{
+		// the accumulators are per candidate rather than per ordinal, so a selective query never touches the rest of the shard
+		accumulators.assign(std::size(candidates), 0.0);
+
+		// an interruptible query checks its deadline and stop token every block of postings,
+		// once stopped it ranks whatever it has accumulated so far
+		QueryChecker checker{ options, status, postingBlockSize };
+		QueryChecker* const interruptible{ isInterruptible(options) ? &checker : nullptr };
+
+		std::vector<PostingIntersection::Match> matches{};
+		for (const WeightedPostings& weighted : terms)
+		{
+			// lhs are candidate positions, rhs posting positions
+			matches.clear();
+			if (!weighted.postings->roaring && !interruptible) [[likely]]
+			{
+				PostingIntersection::intersect(candidates, weighted.postings->ordinals, matches);
+			}
+			else if (!weighted.postings->roaring)
+			{
+				intersectChecked(candidates, weighted.postings->ordinals, postingBlockSize, *interruptible, matches);
+			}
+			else
+			{
+				intersectRoaring(candidates, *weighted.postings, postingBlockSize, interruptible, matches);
+			}
+			const std::span<const double> norms{ weighted.postings->norms };
+			for (const PostingIntersection::Match match : matches)
+			{
+				accumulators[match.lhs] += weighted.postings->frequencies[match.rhs] * weighted.idf * (norms.empty() ? 1.0 : norms[candidates[match.lhs]]);
+			}
+
+			if (status != QueryStatus::complete)
+			{
+				break;
+			}
+		}
+
+		return toDocInfos(ScoreKernels::selectTopCandidates(accumulators, candidates, ordinalToInverseSize_, ordinalToDocId_, n));
+	}
+
+	std::vector<DocInfo> CorpusShard::toDocInfos(std::span<const ScoreKernels::ScoredOrdinal> topN) const noexcept
+	{
+		std::vector<DocInfo> ranked{};
+		ranked.reserve(std::size(topN));
+		for (const ScoreKernels::ScoredOrdinal& scored : topN)
+		{
+			ranked.emplace_back(ordinalToDocId_[scored.ordinal], scored.score);
+		}
+
+		return ranked;
+	}
+
+	DocumentStoreStats CorpusShard::documentStoreStats() const noexcept
+	{
+		return documentStore_.stats();
+	}
+
+	PostingCacheStats CorpusShard::postingCacheStats() const noexcept
+	{
+		return postingCache_ ? postingCache_->stats() : PostingCacheStats{};
+	}
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "BooleanQuery.hpp"
+#include "CorpusStatistics.hpp"
+#include "CorpusTypes.hpp"
+#include "DocumentStore.hpp"
+#include "PostingCache.hpp"
+#include "PostingList.hpp"
+#include "QueryResult.hpp"
+#include "Reranker.hpp"
+#include "ScoreKernels.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// one independently locked partition of a corpus' documents, with its own postings and ordinals
+	// the shard does no locking itself: callers hold mutex shared to read it and exclusively to write it
+	class CorpusShard
+	{
+	public:
+		// word to its frequency in a document
+		// once the document is in the shard its words view the shard's dictionary, so they need not its text
+		using DocumentBag = std::unordered_map<std::string_view, Frequency>;
+
+		// the positions of a document's words in one stream, each word's ascending positions as varint encoded gaps
+		// its words view like a DocumentBag's
+		struct WordPositions
+		{
+			std::vector<std::pair<std::string_view, std::uint32_t>> words;		// ascending, with the offset of the word's positions in stream
+			std::vector<std::uint8_t> stream;
+		};
+
+		// where a field sits in its document's text
+		struct FieldExtent
+		{
+			std::string name;
+			std::size_t offset;
+			std::size_t length;
+			ulong words;
+		};
+
+		// every word of a field is also indexed as its field term, which is scored by the field's own length, see fieldTerm
+		struct DocumentFields
+		{
+			std::string terms;							// the field term of every distinct word of every field, released once in the shard
+			DocumentBag bag;							// views into terms, then like a DocumentBag's
+			std::vector<FieldExtent> extents;
+		};
+
+		// a document tokenized before its shard is locked, so the lock is held only to update the index
+		struct PreparedDocument
+		{
+			std::shared_ptr<const std::string> text;
+			DocumentBag bag;							// views into *text
+			WordPositions positions;					// views into *text, empty unless the corpus indexes positions
+			std::unique_ptr<DocumentFields> fields{};	// nullptr for a document without fields
+		};
+
+		// a posting list as flat arrays, holding on to the decoded copy of a compressed list
+		// a roaring list's ordinals stay in its bitmap and are read block by block, only its frequencies are flat
+		struct PostingsView
+		{
+			std::span<const DocOrdinal> ordinals;		// empty for a roaring list
+			std::span<const Frequency> frequencies;
+			PostingCache::DecodedPtr decoded;
+			std::span<const double> norms;				// by ordinal, for a field term, see ScoreKernels::accumulate
+			const RoaringBitmap* roaring{ nullptr };
+
+			[[nodiscard]] std::size_t size() const noexcept { return std::size(frequencies); }
+		};
+
+		// a query word's postings in this shard with its corpus-wide idf
+		struct WeightedPostings
+		{
+			const PostingsView* postings;
+			double idf;
+		};
+
+		// likewise for a word of several queries ranked together, by their positions among them
+		struct SharedPostings
+		{
+			const PostingsView* postings;
+			double idf;
+			std::vector<std::size_t> queries;
+		};
+
+		mutable std::shared_mutex mutex;
+
+
+		// every document added or removed is counted in statistics, which all shards of a corpus share
+		// a shard indexing positions expects them in every document it is given
+		// documentBlockBytes other than 0 compresses the texts in blocks, see DocumentStore
+		// without storeDocuments the texts are dropped once indexed, and findDocument always returns none
+		CorpusShard(CorpusStatistics& statistics, const bool compressPostings, const std::size_t postingCacheBytes, const bool indexPositions,
+			const std::size_t documentBlockBytes = 0U, const std::size_t documentCacheBlocks = 0U, const bool storeDocuments = true);
+
+		static DocumentBag getDocumentBag(std::string_view doc);
+
+		static WordPositions getWordPositions(std::string_view doc);
+
+		static PreparedDocument prepareDocument(std::string_view doc, const bool withPositions = false);
+
+		// the text of the document is its fields' texts joined by spaces
+		static PreparedDocument prepareDocument(std::span<const DocumentField> fields, const bool withPositions = false);
+
+		// the dictionary word of a field's word, name and word joined by a space
+		// getDocumentBag splits at spaces, so no word of a text can ever collide with it
+		static std::string fieldTerm(std::string_view name, std::string_view word);
+
+		[[nodiscard]] std::size_t size() const noexcept { return std::size(docIdToOrdinal_); }
+
+		[[nodiscard]] bool contains(const DocId docId) const noexcept { return docIdToOrdinal_.contains(docId); }
+
+		// #(words in the document), 0 if the shard does not hold it
+		[[nodiscard]] std::size_t documentLength(const DocId docId) const noexcept;
+
+		[[nodiscard]] std::optional<PinnedText> findDocument(const DocId docId) const noexcept;
+
+		// the offset and length of the field in findDocument(docId), none if the document has no such field
+		[[nodiscard]] std::optional<std::pair<std::size_t, std::size_t>> findField(const DocId docId, std::string_view name) const noexcept;
+
+		// whether any document of the shard ever had a field of the name
+		[[nodiscard]] bool hasField(std::string_view name) const noexcept { return fieldToNorms_.contains(name); }
+
+		bool insertDocument(const DocId docId, PreparedDocument doc) noexcept;
+
+		// only marks the document's ordinal dead, its postings stay until purgeDeleted and are skipped while ranking
+		bool eraseDocument(const DocId docId) noexcept;
+
+		// #(erased documents whose postings are not purged yet)
+		[[nodiscard]] std::size_t deletedCount() const noexcept { return std::size(deadOrdinals_); }
+
+		// #(ordinals in use, live or dead)
+		[[nodiscard]] std::size_t ordinalCount() const noexcept { return std::size(ordinalToDocId_) - std::size(freeOrdinals_); }
+
+		// whether a purge has work: at least deletedRatio of the ordinals in use are dead, or blocks of texts wait to be compacted
+		[[nodiscard]] bool needsPurge(const double deletedRatio) const noexcept;
+
+		// true only for the first call since the last purge, so a purge is scheduled once
+		[[nodiscard]] bool schedulePurge() noexcept { return !std::exchange(purgeScheduled_, true); }
+
+		// erases the postings of the dead ordinals and frees them for reuse, and compacts the mostly dead blocks of texts
+		// returns #(documents purged)
+		std::size_t purgeDeleted() noexcept;
+
+		// replaces an existing document in one step, so readers never observe it missing
+		// only the postings of words whose membership or frequency changed are touched
+		bool replaceDocument(const DocId docId, PreparedDocument doc) noexcept;
+
+		// #(live documents of the shard which contain the word)
+		[[nodiscard]] std::size_t documentFrequency(std::string_view word) const noexcept;
+
+		[[nodiscard]] std::optional<PostingsView> viewPostings(std::string_view word) const noexcept;
+
+		// the live ordinals of within whose documents contain the word, of every live document if within is nullptr, see BooleanQuery
+		// with a checker the matching stops once the query is stopped, returning what it matched so far
+		[[nodiscard]] std::vector<DocOrdinal> matchTerm(std::string_view word, const std::vector<DocOrdinal>* within,
+			QueryChecker* checker = nullptr) const noexcept;
+
+		// likewise for the phrase, whose words are intersected from the rarest on
+		// without positions it falls back to the documents which contain all of the words
+		[[nodiscard]] std::vector<DocOrdinal> matchPhrase(std::span<const std::string_view> words, std::optional<std::uint32_t> slop,
+			const std::vector<DocOrdinal>* within, QueryChecker* checker = nullptr) const noexcept;
+
+		// none without positions, or if the document holds fewer than two of the words
+		[[nodiscard]] std::optional<ProximityWindow> proximityWindow(const DocId docId, std::span<const std::string_view> words) const noexcept;
+
+		// accumulators is scratch space, so callers ranking many queries can reuse it
+		// an interruptible query stops accumulating once checkQueryOptions fails and ranks what it has so far
+		// a boolean query ranks only the documents it matches, and only their postings are accumulated
+		// its matching is checked every block of postings too, and ranks nothing once stopped
+		[[nodiscard]] std::vector<DocInfo> rank(std::span<const WeightedPostings> terms, const std::size_t n, std::vector<double>& accumulators,
+			const QueryOptions& options, QueryStatus& status, const BooleanQuery* filter = nullptr) const noexcept;
+
+		// ranks nQueries plain queries in one pass over their posting lists, the top n of each by its position
+		// each block of a list is accumulated into every query holding the word while it is hot, accumulators holds an array per query
+		[[nodiscard]] std::vector<std::vector<DocInfo>> rankShared(std::span<const SharedPostings> terms, const std::size_t nQueries, const std::size_t n,
+			std::vector<std::vector<double>>& accumulators) const noexcept;
+
+		[[nodiscard]] PostingCacheStats postingCacheStats() const noexcept;
+
+		[[nodiscard]] DocumentStoreStats documentStoreStats() const noexcept;
+
+	private:
+		// a word's posting list, with #(live documents) in it, the word's document frequency in the shard
+		// the postings of erased documents stay until purgeDeleted, the count forgets them at once
+		struct WordPostings
+		{
+			PostingList postings;
+			std::uint32_t documentFrequency{ 0U };
+		};
+
+		// word to the posting list of the documents which it appears in
+		// the functors are so unordered_map could look up both std::string and std::string_view
+		// as std::string_view can be implicitly constructed from std::string
+		// the dictionary holds the only copy of a word, the corpus sums the shards' document frequencies per query word
+		using WordToPostings = std::unordered_map<std::string, WordPostings, string_view_hash, string_view_equal>;
+
+		// document id to its document bag
+		using DocIdToDocumentBag = std::unordered_map<DocId, DocumentBag>;
+
+		// the fields are boxed, so the views of their bags survive rehashing
+		using DocIdToFields = std::unordered_map<DocId, std::unique_ptr<const DocumentFields>>;
+
+		// field name to #(words in document) / #(words in field) by ordinal, 0 where the document lacks the field
+		using FieldToNorms = std::unordered_map<std::string, std::vector<double>, string_view_hash, string_view_equal>;
+
+
+		// postings accumulated between two checks of an interruptible query's deadline and stop token
+		static constexpr std::size_t postingBlockSize{ 4096U };
+
+
+		WordToPostings wordToPostings_;						// stores strings
+		DocIdToDocumentBag docIdToDocBag_;					// stores string_views of wordToPostings_
+		DocumentStore documentStore_;						// texts are shared, so query results can pin the ones they return
+		bool storeDocuments_;
+		DocIdToFields docIdToFields_;						// only documents with fields
+		FieldToNorms fieldToNorms_;
+
+		// documents are addressed by dense ordinals while scoring, freed ordinals are reused
+		std::unordered_map<DocId, DocOrdinal> docIdToOrdinal_;
+		std::vector<DocId> ordinalToDocId_;
+		std::vector<double> ordinalToInverseSize_;			// 1 / #(words in document), 0 for free ordinals
+		std::vector<std::uint64_t> liveOrdinals_;			// bitmap of the ordinals which hold a document
+		std::vector<DocOrdinal> freeOrdinals_;
+		std::vector<DocOrdinal> deadOrdinals_;				// erased, but still in the postings
+		bool purgeScheduled_{ false };
+
+		CorpusStatistics& statistics_;
+		bool compressPostings_;
+		bool indexPositions_;
+		std::vector<WordPositions> ordinalToPositions_;	// stores string_views of wordToPostings_, empty unless positions are indexed
+		std::unique_ptr<PostingCache> postingCache_;		// decoded compressed posting lists of hot words
+
+
+		// the ordinals which filter matches, ascending, checked every block of postings with a checker
+		std::vector<DocOrdinal> matchOrdinals(const BooleanQuery& filter, QueryChecker* checker) const noexcept;
+
+		// every live ordinal, ascending
+		std::vector<DocOrdinal> listLiveOrdinals() const noexcept;
+
+		std::vector<DocInfo> rankCandidates(std::span<const WeightedPostings> terms, std::span<const DocOrdinal> candidates, const std::size_t n,
+			std::vector<double>& accumulators, const QueryOptions& options, QueryStatus& status) const noexcept;
+
+		// the positions of a word in a live document, empty if it does not contain the word
+		std::vector<std::uint32_t> positionsOf(const DocOrdinal ordinal, std::string_view word) const noexcept;
+
+		[[nodiscard]] bool isLive(const DocOrdinal ordinal) const noexcept { return (liveOrdinals_[ordinal / 64U] >> (ordinal % 64U)) & 1U; }
+
+		std::vector<DocInfo> toDocInfos(std::span<const ScoreKernels::ScoredOrdinal> topN) const noexcept;
+
+		// returns the word as the dictionary holds it
+		std::string_view addPosting(std::string_view word, const DocOrdinal ordinal, const Frequency frequency) noexcept;
+
+		void removePosting(std::string_view word, const DocOrdinal ordinal) noexcept;
+
+		// touches only the postings of words whose membership or frequency changed, returns newBag on the dictionary's words
+		// the words of oldBag may be gone from the dictionary afterwards
+		DocumentBag diffPostings(const DocumentBag& oldBag, const DocumentBag& newBag, const DocOrdinal ordinal) noexcept;
+
+		// positions on the words of interned
+		static WordPositions internPositions(WordPositions positions, const DocumentBag& interned) noexcept;
+
+		// the norms of a field term, empty for any other word
+		std::span<const double> fieldNorms(std::string_view word) const noexcept;
+
+		void setFieldNorms(const DocumentFields& fields, const DocOrdinal ordinal, const ulong docSize) noexcept;
+
+		static ulong documentSize(const DocumentBag& bag) noexcept;
+
+		DocOrdinal acquireOrdinal(const DocId docId) noexcept;
+
+		void retireOrdinal(const DocOrdinal ordinal) noexcept;
+	};
+}
@@ -0,0 +1,28 @@
+#include "CorpusStatistics.hpp"
+
+
+namespace RelDocFinder
+{
+	double CorpusStatistics::averageLength() const noexcept
+	{
+		const std::size_t count{ documentCount() };
+		return count != 0U ? static_cast<double>(totalLength()) / static_cast<double>(count) : 0.0;
+	}
+
+	void CorpusStatistics::addDocument(const std::uint64_t length) noexcept
+	{
+		documentCount_.fetch_add(1U, std::memory_order_relaxed);
+		totalLength_.fetch_add(length, std::memory_order_relaxed);
+	}
+
+	void CorpusStatistics::removeDocument(const std::uint64_t length) noexcept
+	{
+		documentCount_.fetch_sub(1U, std::memory_order_relaxed);
+		totalLength_.fetch_sub(length, std::memory_order_relaxed);
+	}
+
+	void CorpusStatistics::resizeDocument(const std::uint64_t oldLength, const std::uint64_t newLength) noexcept
+	{
+		totalLength_.fetch_add(newLength - oldLength, std::memory_order_relaxed);		// wraps around when the document shrinks
+	}
+}
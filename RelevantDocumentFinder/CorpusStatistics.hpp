@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace RelDocFinder
+{
+	// corpus-wide counts which scoring needs, maintained by every mutation instead of being merged from the shards per query
+	// the counters are atomics: writers of different shards update them concurrently, readers never wait for a writer's shard lock
+	// the shards update them while locked, so a reader holding every shard lock sees them consistent with the postings
+	// a word's document frequency is kept next to its postings in every shard instead, see Corpus::documentFrequency
+	class CorpusStatistics
+	{
+	public:
+		[[nodiscard]] std::size_t documentCount() const noexcept { return documentCount_.load(std::memory_order_relaxed); }
+
+		// #(words in all documents)
+		[[nodiscard]] std::uint64_t totalLength() const noexcept { return totalLength_.load(std::memory_order_relaxed); }
+
+		[[nodiscard]] double averageLength() const noexcept;
+
+		void addDocument(const std::uint64_t length) noexcept;
+
+		void removeDocument(const std::uint64_t length) noexcept;
+
+		void resizeDocument(const std::uint64_t oldLength, const std::uint64_t newLength) noexcept;
+
+	private:
+		std::atomic<std::size_t> documentCount_{ 0U };
+		std::atomic<std::uint64_t> totalLength_{ 0U };
+	};
+}
@@ -2,6 +2,84 @@
 #include "catch.hpp"
 
 #include "Corpus.hpp"
+#include "CsvReader.hpp"
+#include "DocumentStore.hpp"
+#include "JsonlReader.hpp"
+#include "Lz77.hpp"
+#include "PostingIntersection.hpp"
+#include "RoaringBitmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <stdexcept>
+#include <thread>
+
+
+namespace
+{
+	// a coroutine which starts eagerly and reports the result of the search it awaits
+	struct SearchTask
+	{
+		struct promise_type
+		{
+			SearchTask get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept {}
+		};
+	};
+
+	SearchTask awaitSearch(const RelDocFinder::Corpus& corpus, std::promise<RelDocFinder::QueryResult>& promise)
+	{
+		promise.set_value(co_await corpus.awaitSearchQuery("happy day", 3U));
+	}
+
+	// a stream buffer which fails with an exception once its text is read
+	class FailingBuffer : public std::streambuf
+	{
+	public:
+		explicit FailingBuffer(std::string text) : text_{ std::move(text) }
+		{
+			setg(text_.data(), text_.data(), text_.data() + std::size(text_));
+		}
+
+	protected:
+		int_type underflow() override
+		{
+			throw std::runtime_error{ "read failed" };
+		}
+
+	private:
+		std::string text_;
+	};
+
+	// the ids of the hits, best first
+	std::vector<RelDocFinder::DocId> docIds(const RelDocFinder::QueryResult& queryRes)
+	{
+		std::vector<RelDocFinder::DocId> ids{};
+		for (const RelDocFinder::QueryHit& hit : queryRes)
+		{
+			ids.push_back(hit.docId);
+		}
+		return ids;
+	}
+
+	// the ids of the hits ascending, for queries which only decide which documents match
+	std::vector<RelDocFinder::DocId> sortedDocIds(const RelDocFinder::QueryResult& queryRes)
+	{
+		std::vector<RelDocFinder::DocId> ids{ docIds(queryRes) };
+		std::ranges::sort(ids);
+		return ids;
+	}
+}
 
 
 TEST_CASE("Corpus", "[Corpus]")
@@ -10,38 +88,38 @@ TEST_CASE("Corpus", "[Corpus]")
 	
 	SECTION("Corpus::getDocument")
 	{
-		std::optional<std::string_view> badDoc1 = corpus.getDocument(-1);
+		std::optional<RelDocFinder::PinnedText> badDoc1 = corpus.getDocument(-1);
 		REQUIRE(!badDoc1.has_value());
 
-		std::optional<std::string_view> goodDoc0 = corpus.getDocument(0U);
+		std::optional<RelDocFinder::PinnedText> goodDoc0 = corpus.getDocument(0U);
 		REQUIRE(goodDoc0 == "happy day");
 
-		std::optional<std::string_view> goodDoc1 = corpus.getDocument(1U);
+		std::optional<RelDocFinder::PinnedText> goodDoc1 = corpus.getDocument(1U);
 		REQUIRE(*goodDoc1 == "happy");
 
-		std::optional<std::string_view> goodDoc2 = corpus.getDocument(2U);
+		std::optional<RelDocFinder::PinnedText> goodDoc2 = corpus.getDocument(2U);
 		REQUIRE(*goodDoc2 == "day");
 
-		std::optional<std::string_view> goodDoc3 = corpus.getDocument(3U);
+		std::optional<RelDocFinder::PinnedText> goodDoc3 = corpus.getDocument(3U);
 		REQUIRE(*goodDoc3 == "have a nice day");
 
-		std::optional<std::string_view> goodDoc4 = corpus.getDocument(4U);
+		std::optional<RelDocFinder::PinnedText> goodDoc4 = corpus.getDocument(4U);
 		REQUIRE(*goodDoc4 == "colorless green ideas sleep furiously");
 
-		std::optional<std::string_view> badDoc17 = corpus.getDocument(17U);
+		std::optional<RelDocFinder::PinnedText> badDoc17 = corpus.getDocument(17U);
 		REQUIRE(!badDoc17.has_value());
 	}
 
 	SECTION("Corpus::searchQuery")
 	{
 		constexpr int n{ 3 };
-		std::unique_ptr<std::string_view[]> queryRes = corpus.searchQuery("happy day", n);
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy day", n);
 
 		constexpr std::string_view expected[] = { "happy", "happy day",  "day" };
 
 		for (int i = 0; i < n; ++i)
 		{
-			REQUIRE(queryRes[i] == expected[i]);
+			REQUIRE(queryRes[i].text == expected[i]);
 		}
 	}
 
@@ -51,17 +129,18 @@ TEST_CASE("Corpus", "[Corpus]")
 		REQUIRE(!corpus.addDocument(0U, "happy day"));
 
 		REQUIRE(corpus.addDocument(5U, "green dog"));
-		std::optional<std::string_view> doc5 = corpus.getDocument(5U);
+		std::optional<RelDocFinder::PinnedText> doc5 = corpus.getDocument(5U);
 		REQUIRE(*doc5 == "green dog");
 
 		constexpr int n{ 3 };
-		std::unique_ptr<std::string_view[]> queryRes = corpus.searchQuery("green", n);
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("green", n);
 
-		constexpr std::string_view expected[] = { "green dog", "colorless green ideas sleep furiously", "happy" };
+		// the remaining documents all score 0, ties go to the lowest DocId
+		constexpr std::string_view expected[] = { "green dog", "colorless green ideas sleep furiously", "happy day" };
 
 		for (int i = 0; i < n; ++i)
 		{
-			REQUIRE(queryRes[i] == expected[i]);
+			REQUIRE(queryRes[i].text == expected[i]);
 		}
 	}
 
@@ -73,13 +152,13 @@ TEST_CASE("Corpus", "[Corpus]")
 		REQUIRE(corpus.deleteDocument(0U));
 
 		constexpr int n{ 3 };
-		std::unique_ptr<std::string_view[]> queryRes = corpus.searchQuery("happy day", n);
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy day", n);
 
 		constexpr std::string_view expected[] = { "happy", "day",  "have a nice day" };
 
 		for (int i = 0; i < n; ++i)
 		{
-			REQUIRE(queryRes[i] == expected[i]);
+			REQUIRE(queryRes[i].text == expected[i]);
 		}
 	}
 
@@ -87,14 +166,1189 @@ TEST_CASE("Corpus", "[Corpus]")
 	{
 		REQUIRE(corpus.updateDocument(3U, "happy day"));
 
+		constexpr int n{ 4 };
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy day", n);
+
+		// documents 0 to 3 all score idf("happy") == idf("day"), ties go to the lowest DocId
+		constexpr std::string_view expected[] = { "happy day", "happy", "day", "happy day" };
+
+		for (int i = 0; i < n; ++i)
+		{
+			REQUIRE(queryRes[i].text == expected[i]);
+		}
+	}
+
+	SECTION("Corpus::searchQuery over many documents")
+	{
+		// document i holds (i % 10 + 1) times "x" if i % 3 == 0, padded with "y" to 10 words
+		for (RelDocFinder::DocId docId = 100U; docId < 200U; ++docId)
+		{
+			const auto nX{ docId % 3U == 0U ? docId % 10U + 1U : 0U };
+			std::string doc{};
+			for (RelDocFinder::DocId i = 0U; i < 10U; ++i)
+			{
+				doc += i < nX ? "x " : "y ";
+			}
+			REQUIRE(corpus.addDocument(docId, doc));
+		}
+
+		constexpr int n{ 3 };
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("x", n);
+
+		const std::string_view expected{ "x x x x x x x x x x " };
+
+		for (int i = 0; i < n; ++i)
+		{
+			REQUIRE(queryRes[i].text == expected);
+		}
+
+		REQUIRE(corpus.deleteDocument(129U));
+		REQUIRE(corpus.deleteDocument(159U));
+		REQUIRE(corpus.deleteDocument(189U));
+		REQUIRE(corpus.deleteDocument(199U));
+
+		queryRes = corpus.searchQuery("x", n);
+
+		REQUIRE(queryRes[0].text == "x x x x x x x x x y ");
+	}
+
+	SECTION("Corpus::searchQuery with a query cache")
+	{
+		RelDocFinder::Corpus cachedCorpus{ "init_docs.txt", RelDocFinder::CorpusOptions{ .queryCacheCapacity = 2U } };
+
+		constexpr int n{ 2 };
+		for (int repeat = 0; repeat < 2; ++repeat)
+		{
+			// the same bag of words in a different order is the same cached query
+			RelDocFinder::QueryResult queryRes = cachedCorpus.searchQuery(repeat == 0 ? "green sleep" : "sleep green", n);
+			REQUIRE(queryRes[0].text == "colorless green ideas sleep furiously");
+			REQUIRE(queryRes[1].text == "happy day");
+		}
+
+		REQUIRE(cachedCorpus.addDocument(5U, "sleep"));
+
+		RelDocFinder::QueryResult queryRes = cachedCorpus.searchQuery("green sleep", n);
+		REQUIRE(queryRes[0].text == "sleep");
+		REQUIRE(queryRes[1].text == "colorless green ideas sleep furiously");
+	}
+
+	SECTION("Corpus::searchQuery with compressed postings")
+	{
+		RelDocFinder::Corpus compressedCorpus{ "init_docs.txt", RelDocFinder::CorpusOptions{ .compressPostings = true, .postingCacheBytes = 4096U } };
+
+		constexpr int n{ 3 };
+		constexpr std::string_view expected[] = { "happy", "happy day",  "day" };
+
+		for (int repeat = 0; repeat < 2; ++repeat)
+		{
+			RelDocFinder::QueryResult queryRes = compressedCorpus.searchQuery("happy day", n);
+			for (int i = 0; i < n; ++i)
+			{
+				REQUIRE(queryRes[i].text == expected[i]);
+			}
+		}
+
+		const RelDocFinder::PostingCacheStats stats{ compressedCorpus.postingCacheStats() };
+		REQUIRE(stats.misses == 2U);
+		REQUIRE(stats.hits == 2U);
+		REQUIRE(stats.bytes > 0U);
+
+		// writes drop the cached lists of the words they touch
+		REQUIRE(compressedCorpus.deleteDocument(1U));
+		REQUIRE(compressedCorpus.updateDocument(2U, "happy"));
+
+		RelDocFinder::QueryResult queryRes = compressedCorpus.searchQuery("happy", n);
+		REQUIRE(queryRes[0].text == "happy");
+		REQUIRE(queryRes[1].text == "happy day");
+		REQUIRE(compressedCorpus.postingCacheStats().misses == 3U);
+	}
+
+	SECTION("QueryResult outlives its documents")
+	{
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy", 10U);
+
+		// only the 5 documents of the corpus are returned
+		REQUIRE(queryRes.size() == 5U);
+		REQUIRE(queryRes[0].docId == 1U);
+		REQUIRE(queryRes[0].score > queryRes[1].score);
+		REQUIRE(queryRes[4].score == 0.0);
+
+		REQUIRE(corpus.deleteDocument(1U));
+		REQUIRE(corpus.updateDocument(0U, "sad day"));
+
+		REQUIRE(queryRes[0].text == "happy");
+		REQUIRE(queryRes[1].text == "happy day");
+	}
+
+	SECTION("Corpus::searchQueryIds and Corpus::fetchDocuments")
+	{
+		constexpr int n{ 3 };
+		const std::vector<RelDocFinder::DocInfo> ranked = corpus.searchQueryIds("happy day", n);
+		const RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy day", n);
+
+		REQUIRE(ranked.size() == n);
+		for (int i = 0; i < n; ++i)
+		{
+			REQUIRE(ranked[i].docId == queryRes[i].docId);
+			REQUIRE(ranked[i].tfIdfScore == queryRes[i].score);
+		}
+
+		constexpr RelDocFinder::DocId docIds[] = { 3U, 17U, 0U };
+		const std::vector<std::optional<RelDocFinder::PinnedText>> docs = corpus.fetchDocuments(docIds);
+
+		REQUIRE(docs.size() == 3U);
+		REQUIRE(*docs[0] == "have a nice day");
+		REQUIRE(!docs[1]);
+		REQUIRE(*docs[2] == "happy day");
+	}
+
+	SECTION("Corpus::searchQueries")
+	{
+		constexpr std::string_view queries[] = { "happy day", "green", "nice day", "happy day", "missing", "" };
+		constexpr int n{ 3 };
+
+		const auto requireAsSearched = [&corpus](std::span<const std::string_view> batch, const std::vector<RelDocFinder::QueryResult>& results)
+		{
+			REQUIRE(results.size() == batch.size());
+			for (std::size_t q = 0; q < batch.size(); ++q)
+			{
+				const RelDocFinder::QueryResult expected = corpus.searchQuery(batch[q], n);
+				REQUIRE(results[q].size() == expected.size());
+				for (std::size_t i = 0; i < expected.size(); ++i)
+				{
+					REQUIRE(results[q][i].docId == expected[i].docId);
+					REQUIRE(results[q][i].score == expected[i].score);
+				}
+			}
+		};
+		requireAsSearched(queries, corpus.searchQueries(queries, n));
+
+		// more queries than a pass ranks together, and boolean queries among them
+		std::vector<std::string_view> many{};
+		for (std::size_t q = 0; q < 40U; ++q)
+		{
+			many.push_back(q % 3U == 0U ? "happy AND -green" : queries[q % std::size(queries)]);
+		}
+		requireAsSearched(many, corpus.searchQueries(many, n));
+
+		// a batch may run from a task of the executor, which then helps itself
+		RelDocFinder::Corpus singleThreaded{ "init_docs.txt", RelDocFinder::CorpusOptions{ .executorThreads = 1U } };
+		std::promise<std::size_t> nested{};
+		singleThreaded.searchQueryAsync("happy", 1U, [&](RelDocFinder::QueryResult) { nested.set_value(singleThreaded.searchQueries(many, n).size()); });
+		REQUIRE(nested.get_future().get() == many.size());
+	}
+
+	SECTION("Corpus::searchQueryAsync")
+	{
+		constexpr std::string_view expected[] = { "happy", "happy day",  "day" };
+
+		std::future<RelDocFinder::QueryResult> future = corpus.searchQueryAsync("happy day", 3U);
+
+		std::promise<RelDocFinder::QueryResult> callbackPromise{};
+		corpus.searchQueryAsync("happy day", 3U, [&callbackPromise](RelDocFinder::QueryResult result) { callbackPromise.set_value(std::move(result)); });
+
+		std::promise<RelDocFinder::QueryResult> coroutinePromise{};
+		awaitSearch(corpus, coroutinePromise);
+
+		for (const RelDocFinder::QueryResult& queryRes : { future.get(), callbackPromise.get_future().get(), coroutinePromise.get_future().get() })
+		{
+			REQUIRE(queryRes.status() == RelDocFinder::QueryStatus::complete);
+			REQUIRE(queryRes.size() == 3U);
+			for (int i = 0; i < 3; ++i)
+			{
+				REQUIRE(queryRes[i].text == expected[i]);
+			}
+		}
+
+		std::stop_source stopSource{};
+		stopSource.request_stop();
+		const RelDocFinder::QueryResult cancelled = corpus.searchQueryAsync("happy day", 3U, { .stopToken = stopSource.get_token() }).get();
+		REQUIRE(cancelled.status() == RelDocFinder::QueryStatus::cancelled);
+		REQUIRE(cancelled.empty());
+
+		const RelDocFinder::QueryResult late = corpus.searchQueryAsync("happy day", 3U, { .deadline = std::chrono::steady_clock::now() }).get();
+		REQUIRE(late.status() == RelDocFinder::QueryStatus::deadlineExceeded);
+		REQUIRE(late.empty());
+	}
+
+	SECTION("Corpus::searchQuery with a deadline and a stop token")
+	{
 		constexpr int n{ 3 };
-		std::unique_ptr<std::string_view[]> queryRes = corpus.searchQuery("happy day", n);
+		constexpr std::string_view expected[] = { "happy", "happy day",  "day" };
 
-		constexpr std::string_view expected[] = { "happy day", "happy day", "happy"};
+		std::stop_source stopSource{};
+		const RelDocFinder::QueryOptions options{ std::chrono::steady_clock::now() + std::chrono::hours{ 1 }, stopSource.get_token() };
 
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("happy day", n, options);
+		REQUIRE(!queryRes.isPartial());
 		for (int i = 0; i < n; ++i)
 		{
-			REQUIRE(queryRes[i] == expected[i]);
+			REQUIRE(queryRes[i].text == expected[i]);
 		}
+
+		stopSource.request_stop();
+		queryRes = corpus.searchQuery("happy day", n, options);
+		REQUIRE(queryRes.isPartial());
+		REQUIRE(queryRes.status() == RelDocFinder::QueryStatus::cancelled);
+		REQUIRE(corpus.searchQuery("happy AND day", n, options).status() == RelDocFinder::QueryStatus::cancelled);
+
+		// the checker looks at the options once per interval steps, and stays stopped
+		RelDocFinder::QueryStatus status{ RelDocFinder::QueryStatus::complete };
+		RelDocFinder::QueryChecker checker{ options, status, 4U };
+		REQUIRE(!checker.stopped(3U));
+		REQUIRE(checker.stopped(1U));
+		REQUIRE(status == RelDocFinder::QueryStatus::cancelled);
+		REQUIRE(checker.stopped(0U));
+	}
+
+	SECTION("Corpus::searchQuery stopped midway through its postings")
+	{
+		// "common" spans dozens of posting blocks, "rare" one, and the rarest word is scored first
+		RelDocFinder::Corpus large{ RelDocFinder::CorpusOptions{ .shardCount = 1U } };
+		for (RelDocFinder::DocId docId = 0U; docId < 262144U; ++docId)
+		{
+			REQUIRE(large.addDocument(docId, docId % 1024U == 0U ? "rare common" : docId % 2U == 0U ? "common filler" : "filler"));
+		}
+
+		const RelDocFinder::QueryResult complete = large.searchQuery("rare common", 3U);
+		REQUIRE(!complete.isPartial());
+
+		// the stop is requested ever later, until one lands between two blocks of "common"
+		bool stoppedMidway{ false };
+		for (int attempt = 0; attempt < 500 && !stoppedMidway; ++attempt)
+		{
+			std::stop_source stopSource{};
+			const RelDocFinder::QueryOptions options{ std::nullopt, stopSource.get_token() };
+			std::future<RelDocFinder::QueryResult> running{ std::async(std::launch::async, [&large, &options]() { return large.searchQuery("rare common", 3U, options); }) };
+
+			std::this_thread::sleep_for(std::chrono::microseconds{ attempt * 10 });
+			stopSource.request_stop();
+			const RelDocFinder::QueryResult partial = running.get();
+
+			REQUIRE(partial.size() <= 3U);
+			if (!partial.isPartial() || partial.empty() || partial[0].score == 0.0)
+			{
+				continue;
+			}
+
+			// the best so far hold "rare", but not all of "common" was added to them
+			stoppedMidway = true;
+			REQUIRE(partial.status() == RelDocFinder::QueryStatus::cancelled);
+			REQUIRE(partial[0].docId % 1024U == 0U);
+			REQUIRE(partial[0].score <= complete[0].score);
+		}
+		REQUIRE(stoppedMidway);
+	}
+
+	SECTION("Corpus with several shards")
+	{
+		RelDocFinder::Corpus oneShard{ "init_docs.txt", RelDocFinder::CorpusOptions{ .shardCount = 1U } };
+		RelDocFinder::Corpus fourShards{ "init_docs.txt", RelDocFinder::CorpusOptions{ .shardCount = 4U } };
+
+		for (RelDocFinder::Corpus* sharded : { &oneShard, &fourShards })
+		{
+			for (RelDocFinder::DocId docId = 5U; docId < 40U; ++docId)
+			{
+				REQUIRE(sharded->addDocument(docId, docId % 2U == 0U ? "happy green day" : "sad green day"));
+			}
+			REQUIRE(sharded->deleteDocument(7U));
+			REQUIRE(sharded->updateDocument(8U, "happy happy"));
+			REQUIRE(*sharded->getDocument(8U) == "happy happy");
+		}
+
+		constexpr std::string_view queries[] = { "happy day", "green", "sad furiously", "happy" };
+		const std::vector<RelDocFinder::QueryResult> batch = fourShards.searchQueries(queries, 5U);
+		for (std::size_t q = 0; q < std::size(queries); ++q)
+		{
+			const RelDocFinder::QueryResult expected = oneShard.searchQuery(queries[q], 5U);
+			const RelDocFinder::QueryResult queryRes = fourShards.searchQuery(queries[q], 5U);
+			REQUIRE(queryRes.size() == expected.size());
+			REQUIRE(batch[q].size() == expected.size());
+			for (std::size_t i = 0; i < expected.size(); ++i)
+			{
+				REQUIRE(queryRes[i].docId == expected[i].docId);
+				REQUIRE(queryRes[i].score == expected[i].score);
+				REQUIRE(batch[q][i].docId == expected[i].docId);
+			}
+		}
+	}
+
+	SECTION("Corpus::addOrUpdateDocument")
+	{
+		REQUIRE(!corpus.updateDocument(5U, "green dog"));
+		REQUIRE(!corpus.updateDocument(0U, ""));
+		REQUIRE(*corpus.getDocument(0U) == "happy day");
+
+		REQUIRE(corpus.addOrUpdateDocument(5U, "green dog"));
+		REQUIRE(*corpus.getDocument(5U) == "green dog");
+
+		REQUIRE(corpus.addOrUpdateDocument(5U, "green cat"));
+		REQUIRE(*corpus.getDocument(5U) == "green cat");
+
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("cat", 1U);
+		REQUIRE(queryRes[0].docId == 5U);
+
+		queryRes = corpus.searchQuery("dog", 1U);
+		REQUIRE(queryRes[0].score == 0.0);
+	}
+
+	SECTION("Corpus::updateDocument touches only the changed words")
+	{
+		for (const bool compressPostings : { false, true })
+		{
+			RelDocFinder::Corpus diffed{ "init_docs.txt", RelDocFinder::CorpusOptions{ .compressPostings = compressPostings, .postingCacheBytes = 1U << 16U } };
+
+			REQUIRE(diffed.searchQuery("furiously", 1U)[0].docId == 4U);
+
+			// drops colorless and furiously, doubles green, keeps ideas and sleep, adds day
+			REQUIRE(diffed.updateDocument(4U, "green green ideas sleep day"));
+			REQUIRE(*diffed.getDocument(4U) == "green green ideas sleep day");
+
+			RelDocFinder::QueryResult queryRes = diffed.searchQuery("furiously colorless", 1U);
+			REQUIRE(queryRes[0].score == 0.0);
+
+			queryRes = diffed.searchQuery("green", 1U);
+			REQUIRE(queryRes[0].docId == 4U);
+			REQUIRE(queryRes[0].score == Approx(2.0 / 5.0 * std::log10(5.0)));
+
+			queryRes = diffed.searchQuery("sleep", 1U);
+			REQUIRE(queryRes[0].docId == 4U);
+			REQUIRE(queryRes[0].text == "green green ideas sleep day");
+
+			queryRes = diffed.searchQuery("day", 5U);
+			REQUIRE(queryRes[3].docId == 4U);
+			REQUIRE(queryRes[3].score > 0.0);
+			REQUIRE(queryRes[4].score == 0.0);
+		}
+	}
+
+	SECTION("Corpus::statistics")
+	{
+		const RelDocFinder::CorpusStatistics& statistics = corpus.statistics();
+		REQUIRE(statistics.documentCount() == 5U);
+		REQUIRE(statistics.totalLength() == 13U);
+		REQUIRE(statistics.averageLength() == Approx(13.0 / 5.0));
+		REQUIRE(corpus.documentFrequency("day") == 3U);
+		REQUIRE(corpus.documentFrequency("sad") == 0U);
+
+		REQUIRE(corpus.addDocument(5U, "sad day day"));
+		REQUIRE(statistics.documentCount() == 6U);
+		REQUIRE(statistics.totalLength() == 16U);
+		REQUIRE(corpus.documentFrequency("day") == 4U);
+		REQUIRE(corpus.documentFrequency("sad") == 1U);
+
+		REQUIRE(corpus.updateDocument(5U, "sad"));
+		REQUIRE(statistics.totalLength() == 14U);
+		REQUIRE(corpus.documentFrequency("day") == 3U);
+
+		REQUIRE(corpus.deleteDocument(5U));
+		REQUIRE(corpus.deleteDocument(4U));
+		REQUIRE(statistics.documentCount() == 4U);
+		REQUIRE(statistics.totalLength() == 8U);
+		REQUIRE(corpus.documentFrequency("sad") == 0U);
+		REQUIRE(corpus.documentFrequency("green") == 0U);
+	}
+
+	SECTION("Corpus::deleteDocument leaves the postings to be purged")
+	{
+		for (const bool compressPostings : { false, true })
+		{
+			RelDocFinder::Corpus tombstoned{ "init_docs.txt", RelDocFinder::CorpusOptions{ .compressPostings = compressPostings, .shardCount = 1U, .purgeDeletedRatio = 2.0 } };
+
+			REQUIRE(tombstoned.deleteDocument(0U));
+			REQUIRE(tombstoned.deleteDocument(3U));
+			REQUIRE(!tombstoned.deleteDocument(3U));
+			REQUIRE(!tombstoned.getDocument(0U).has_value());
+			REQUIRE(tombstoned.documentFrequency("day") == 1U);
+
+			RelDocFinder::QueryResult queryRes = tombstoned.searchQuery("day", 5U);
+			REQUIRE(queryRes.size() == 3U);
+			REQUIRE(queryRes[0].docId == 2U);
+			REQUIRE(queryRes[0].score == Approx(std::log10(3.0)));
+
+			REQUIRE(tombstoned.addDocument(0U, "nice day"));
+			REQUIRE(tombstoned.purgeDeleted() == 2U);
+			REQUIRE(tombstoned.purgeDeleted() == 0U);
+
+			REQUIRE(tombstoned.addDocument(3U, "nice"));
+			queryRes = tombstoned.searchQuery("nice", 5U);
+			REQUIRE(queryRes[0].docId == 3U);
+			REQUIRE(queryRes[1].docId == 0U);
+			REQUIRE(queryRes[2].score == 0.0);
+			REQUIRE(tombstoned.searchQuery("have", 1U)[0].score == 0.0);
+		}
+
+		// the default ratio purges in the background
+		for (RelDocFinder::DocId docId = 0U; docId < 5U; ++docId)
+		{
+			REQUIRE(corpus.deleteDocument(docId));
+		}
+		REQUIRE(corpus.searchQuery("day", 5U).empty());
+		REQUIRE(corpus.addDocument(0U, "day"));
+		REQUIRE(corpus.searchQuery("day", 5U)[0].docId == 0U);
+	}
+
+	SECTION("RoaringBitmap")
+	{
+		// a dense chunk, a sparse chunk and a chunk of their own for each
+		std::vector<std::uint32_t> evens{}, triples{};
+		for (std::uint32_t value = 0U; value < 200000U; value += 2U)
+		{
+			evens.push_back(value);
+		}
+		for (std::uint32_t value = 0U; value < 300000U; value += value < 70000U ? 3U : 999U)
+		{
+			triples.push_back(value);
+		}
+
+		const RelDocFinder::RoaringBitmap lhs = RelDocFinder::RoaringBitmap::fromSorted(evens);
+		const RelDocFinder::RoaringBitmap rhs = RelDocFinder::RoaringBitmap::fromSorted(triples);
+		REQUIRE(lhs.cardinality() == evens.size());
+		REQUIRE(lhs.contains(65536U));
+		REQUIRE(!lhs.contains(65537U));
+		REQUIRE(lhs.rank(65536U) == 32768U);
+		REQUIRE(rhs.maximum() == triples.back());
+
+		const auto values = [](const RelDocFinder::RoaringBitmap& roaring)
+		{
+			std::vector<std::uint32_t> out{};
+			roaring.appendTo(out);
+			return out;
+		};
+
+		RelDocFinder::RoaringBitmap modified = lhs;
+		REQUIRE(modified.add(1U));
+		REQUIRE(!modified.add(1U));
+		REQUIRE(modified.contains(1U));
+		REQUIRE(modified.remove(1U));
+		REQUIRE(!modified.remove(1U));
+		REQUIRE(values(modified) == evens);
+
+		// a reader returns the same values block by block, across sparse and dense chunks
+		for (const RelDocFinder::RoaringBitmap* roaring : { &lhs, &rhs })
+		{
+			RelDocFinder::RoaringBitmap::Reader reader{ *roaring };
+			std::vector<std::uint32_t> read{};
+			while (reader.read(read, 1000U) != 0U)
+			{
+			}
+			REQUIRE(read == values(*roaring));
+		}
+	}
+
+	SECTION("Corpus with roaring postings")
+	{
+		RelDocFinder::Corpus roaring{ RelDocFinder::CorpusOptions{ .shardCount = 1U } };
+		RelDocFinder::Corpus varint{ RelDocFinder::CorpusOptions{ .compressPostings = true, .shardCount = 1U } };
+
+		for (RelDocFinder::Corpus* dense : { &roaring, &varint })
+		{
+			// "the" is in every document, enough for a roaring posting list
+			for (RelDocFinder::DocId docId = 0U; docId < 10000U; ++docId)
+			{
+				REQUIRE(dense->addDocument(docId, docId % 7U == 0U ? "the the cat" : docId % 2U == 0U ? "the dog" : "the"));
+			}
+			for (RelDocFinder::DocId docId = 0U; docId < 10000U; docId += 5U)
+			{
+				REQUIRE(dense->deleteDocument(docId));
+			}
+			REQUIRE(dense->updateDocument(3U, "the the the"));
+			REQUIRE(dense->purgeDeleted() != 0U);
+			REQUIRE(dense->addDocument(0U, "dog the"));
+			REQUIRE(dense->addDocument(10001U, "the rare"));
+		}
+
+		// the boolean queries score "the" for a few candidates and for many of them
+		for (std::string_view query : { "the", "the cat", "dog", "+rare the", "+the +cat" })
+		{
+			const RelDocFinder::QueryResult expected = varint.searchQuery(query, 10U);
+			const RelDocFinder::QueryResult queryRes = roaring.searchQuery(query, 10U);
+			REQUIRE(queryRes.size() == expected.size());
+			for (std::size_t i = 0; i < expected.size(); ++i)
+			{
+				REQUIRE(queryRes[i].docId == expected[i].docId);
+				REQUIRE(queryRes[i].score == Approx(expected[i].score));
+			}
+		}
+	}
+
+	SECTION("Corpus::searchQuery with boolean operators")
+	{
+		REQUIRE(!RelDocFinder::BooleanQuery::isBoolean("happy well-known day"));
+		REQUIRE(RelDocFinder::BooleanQuery::isBoolean("happy -day"));
+		REQUIRE(RelDocFinder::BooleanQuery::isBoolean("happy AND day"));
+
+		REQUIRE(docIds(corpus.searchQuery("+happy +day", 5U)) == std::vector<RelDocFinder::DocId>{ 0U });
+		REQUIRE(docIds(corpus.searchQuery("happy AND day", 5U)) == std::vector<RelDocFinder::DocId>{ 0U });
+		REQUIRE(docIds(corpus.searchQuery("happy OR day", 5U)) == std::vector<RelDocFinder::DocId>{ 1U, 0U, 2U, 3U });
+		REQUIRE(docIds(corpus.searchQuery("day -happy", 5U)) == std::vector<RelDocFinder::DocId>{ 2U, 3U });
+		REQUIRE(docIds(corpus.searchQuery("-day", 5U)) == std::vector<RelDocFinder::DocId>{ 1U, 4U });
+		REQUIRE(docIds(corpus.searchQuery("(happy OR green) AND -sleep", 5U)) == std::vector<RelDocFinder::DocId>{ 1U, 0U });
+		REQUIRE(docIds(corpus.searchQuery("+happy day", 5U)) == std::vector<RelDocFinder::DocId>{ 1U, 0U });
+		REQUIRE(docIds(corpus.searchQuery("+(nice OR sleep) (colorless", 5U)) == std::vector<RelDocFinder::DocId>{ 4U, 3U });
+
+		// the required words are scored like a plain query's
+		const RelDocFinder::QueryResult plain = corpus.searchQuery("happy day", 5U);
+		const RelDocFinder::QueryResult conjunctive = corpus.searchQuery("+happy +day", 5U);
+		REQUIRE(plain.size() == 5U);
+		REQUIRE(conjunctive[0].score == plain[1].score);
+
+		constexpr std::string_view queries[] = { "+happy +day", "happy day", "-happy" };
+		const std::vector<RelDocFinder::QueryResult> batch = corpus.searchQueries(queries, 5U);
+		REQUIRE(batch[0].size() == 1U);
+		REQUIRE(batch[1].size() == 5U);
+		REQUIRE(docIds(batch[2]) == std::vector<RelDocFinder::DocId>{ 2U, 3U, 4U });
+
+		REQUIRE(corpus.deleteDocument(0U));
+		REQUIRE(corpus.searchQuery("+happy +day", 5U).empty());
+
+		// a rare required word narrows down a common one, deleted documents whose postings remain never match
+		RelDocFinder::Corpus skewed{ RelDocFinder::CorpusOptions{ .shardCount = 1U, .purgeDeletedRatio = 1.0 } };
+		for (RelDocFinder::DocId docId = 0U; docId < 5000U; ++docId)
+		{
+			REQUIRE(skewed.addDocument(docId, docId % 1000U == 0U ? "rare common" : "common"));
+		}
+		REQUIRE(skewed.addDocument(5000U, "rare"));
+		REQUIRE(skewed.deleteDocument(2000U));
+
+		REQUIRE(docIds(skewed.searchQuery("+rare +common", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 1000U, 3000U, 4000U });
+		REQUIRE(docIds(skewed.searchQuery("+common AND rare", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 1000U, 3000U, 4000U });
+		REQUIRE(docIds(skewed.searchQuery("-common", 10U)) == std::vector<RelDocFinder::DocId>{ 5000U });
+		REQUIRE(docIds(skewed.searchQuery("+rare -common", 10U)) == std::vector<RelDocFinder::DocId>{ 5000U });
+		REQUIRE(docIds(skewed.searchQuery("rare OR -common", 10U)) == std::vector<RelDocFinder::DocId>{ 5000U, 0U, 1000U, 3000U, 4000U });
+		REQUIRE(skewed.searchQuery("+common -rare", 5000U).size() == 4995U);
+	}
+
+	SECTION("PostingIntersection")
+	{
+		namespace PI = RelDocFinder::PostingIntersection;
+
+		std::mt19937 random{ 42U };
+		const auto sortedSample = [&random](const std::size_t count, const RelDocFinder::DocOrdinal universe)
+		{
+			std::vector<RelDocFinder::DocOrdinal> sample{};
+			std::uniform_int_distribution<RelDocFinder::DocOrdinal> pick{ 0U, universe - 1U };
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				sample.push_back(pick(random));
+			}
+			std::ranges::sort(sample);
+			sample.erase(std::unique(sample.begin(), sample.end()), sample.end());
+			return sample;
+		};
+
+		const auto ordinalsOf = [](std::span<const RelDocFinder::DocOrdinal> lhs, std::span<const RelDocFinder::DocOrdinal> rhs, const std::vector<PI::Match>& matches)
+		{
+			std::vector<RelDocFinder::DocOrdinal> ordinals{};
+			for (const PI::Match match : matches)
+			{
+				REQUIRE(lhs[match.lhs] == rhs[match.rhs]);
+				ordinals.push_back(lhs[match.lhs]);
+			}
+			return ordinals;
+		};
+
+		for (const auto [lhsCount, rhsCount] : { std::pair{ 1000U, 1000U }, std::pair{ 37U, 5000U }, std::pair{ 3000U, 20U }, std::pair{ 0U, 10U } })
+		{
+			const std::vector<RelDocFinder::DocOrdinal> lhs = sortedSample(lhsCount, 4000U);
+			const std::vector<RelDocFinder::DocOrdinal> rhs = sortedSample(rhsCount, 4000U);
+
+			std::vector<RelDocFinder::DocOrdinal> expected{};
+			std::ranges::set_intersection(lhs, rhs, std::back_inserter(expected));
+
+			for (auto algorithm : { &PI::merge, &PI::gallop, &PI::blockCompare })
+			{
+				std::vector<PI::Match> matches{};
+				algorithm(lhs, rhs, matches);
+				REQUIRE(ordinalsOf(lhs, rhs, matches) == expected);
+			}
+
+			std::vector<PI::Match> matches{};
+			PI::intersect(lhs, rhs, matches);
+			REQUIRE(ordinalsOf(lhs, rhs, matches) == expected);
+
+			std::vector<RelDocFinder::DocOrdinal> ordinals{};
+			PI::intersect(lhs, rhs, ordinals);
+			REQUIRE(ordinals == expected);
+		}
+	}
+
+	SECTION("Corpus::searchQuery with phrases")
+	{
+		RelDocFinder::Corpus positional{ RelDocFinder::CorpusOptions{ .shardCount = 2U, .indexPositions = true } };
+		RelDocFinder::Corpus bagOnly{ RelDocFinder::CorpusOptions{ .shardCount = 2U } };
+		for (RelDocFinder::Corpus* phrased : { &positional, &bagOnly })
+		{
+			REQUIRE(phrased->addDocument(0U, "new york city"));
+			REQUIRE(phrased->addDocument(1U, "york is new"));
+			REQUIRE(phrased->addDocument(2U, "a new  shiny york"));
+			REQUIRE(phrased->addDocument(3U, "new is not york in new york"));
+			REQUIRE(phrased->addDocument(4U, "new things in old york"));
+			REQUIRE(phrased->addDocument(5U, "old york"));
+		}
+
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new york\"", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 3U });
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new york\"~1", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 1U, 2U, 3U });
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new york\"~3", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 1U, 2U, 3U, 4U });
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new york city\"", 10U)) == std::vector<RelDocFinder::DocId>{ 0U });
+		REQUIRE(sortedDocIds(positional.searchQuery("york -\"new york\"", 10U)) == std::vector<RelDocFinder::DocId>{ 1U, 2U, 4U, 5U });
+		REQUIRE(sortedDocIds(positional.searchQuery("\"old york\" OR city", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 4U, 5U });
+
+		// a repeated word needs a position of its own for every repeat
+		REQUIRE(positional.searchQuery("\"new new\"~0", 10U).empty());
+		REQUIRE(positional.searchQuery("\"new new\"", 10U).empty());
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new new\"~4", 10U)) == std::vector<RelDocFinder::DocId>{ 3U });
+		REQUIRE(sortedDocIds(positional.searchQuery("\"new york new\"~3", 10U)) == std::vector<RelDocFinder::DocId>{ 3U });
+
+		// without positions a phrase needs only all of its words
+		REQUIRE(sortedDocIds(bagOnly.searchQuery("\"new york\"", 10U)) == std::vector<RelDocFinder::DocId>{ 0U, 1U, 2U, 3U, 4U });
+
+		REQUIRE(positional.updateDocument(0U, "york new city"));
+		REQUIRE(positional.deleteDocument(3U));
+		REQUIRE(positional.searchQuery("\"new york\"", 10U).empty());
+		REQUIRE(sortedDocIds(positional.searchQuery("\"york new\"", 10U)) == std::vector<RelDocFinder::DocId>{ 0U });
+	}
+
+	SECTION("Corpus::searchQuery with a proximity boost")
+	{
+		RelDocFinder::Corpus positional{ RelDocFinder::CorpusOptions{ .queryCacheCapacity = 8U, .shardCount = 2U, .indexPositions = true } };
+		REQUIRE(positional.addDocument(0U, "new a b c d e york"));
+		REQUIRE(positional.addDocument(1U, "york a b c d e new"));
+		REQUIRE(positional.addDocument(2U, "a b c new york d e"));
+		REQUIRE(positional.addDocument(3U, "a b"));
+		REQUIRE(positional.addDocument(4U, "a b c d e f g"));
+
+		// without the boost the three documents with both words tie
+		RelDocFinder::QueryResult queryRes = positional.searchQuery("new york", 3U);
+		REQUIRE(queryRes[0].docId == 0U);
+		REQUIRE(queryRes[0].score == queryRes[1].score);
+		REQUIRE(queryRes[1].score == queryRes[2].score);
+
+		const double base = queryRes[0].score;
+
+		// adjacent words double the score, words six apart add a sixth
+		RelDocFinder::QueryOptions options{};
+		options.rerankDepth = 100U;
+		options.reranker = RelDocFinder::proximityReranker();
+		queryRes = positional.searchQuery("new york", 3U, options);
+		REQUIRE(queryRes.size() == 3U);
+		REQUIRE(queryRes[0].docId == 2U);
+		REQUIRE(queryRes[0].score == Approx(2.0 * base));
+		REQUIRE(queryRes[1].docId == 0U);
+		REQUIRE(queryRes[1].score == Approx(base * 7.0 / 6.0));
+		REQUIRE(queryRes[2].score == queryRes[1].score);
+
+		// a single word has nothing to be close to
+		const RelDocFinder::QueryResult plain = positional.searchQuery("york", 2U);
+		queryRes = positional.searchQuery("york", 2U, options);
+		REQUIRE(queryRes[0].docId == plain[0].docId);
+		REQUIRE(queryRes[0].score == plain[0].score);
+
+		// the cached, unboosted result is still served
+		queryRes = positional.searchQuery("new york", 3U);
+		REQUIRE(queryRes[0].docId == 0U);
+	}
+
+	SECTION("Corpus::searchQuery with a re-ranker")
+	{
+		std::size_t batches{ 0U };
+		std::vector<RelDocFinder::RerankCandidate> seen{};
+		std::vector<std::string> seenTexts{};
+		RelDocFinder::QueryOptions options{};
+		options.rerankDepth = 10U;
+		options.reranker = [&batches, &seen, &seenTexts](std::span<RelDocFinder::RerankCandidate> candidates, const RelDocFinder::RerankContext& context)
+		{
+			++batches;
+			REQUIRE(std::ranges::equal(context.queryWords, std::vector<std::string_view>{ "day" }));
+			for (RelDocFinder::RerankCandidate& candidate : candidates)
+			{
+				REQUIRE(!context.proximityWindow(candidate.docId));
+				seen.push_back(candidate);
+				seenTexts.emplace_back(context.documentText(candidate.docId));
+				candidate.score *= static_cast<double>(candidate.length * candidate.length);
+			}
+		};
+
+		// tf-idf prefers the shortest document, the re-ranker undoes the length norm and then some
+		REQUIRE(corpus.searchQuery("day", 1U)[0].docId == 2U);
+		RelDocFinder::QueryResult queryRes = corpus.searchQuery("day", 1U, options);
+		REQUIRE(batches == 1U);
+		REQUIRE(queryRes.size() == 1U);
+		REQUIRE(queryRes[0].docId == 3U);
+		REQUIRE(queryRes[0].score == Approx(4.0 * std::log10(5.0 / 3.0)));
+
+		// every first-stage hit is handed over in one batch, with its length, and its text on request
+		REQUIRE(seen.size() == 5U);
+		for (std::size_t i = 0U; i < seen.size(); ++i)
+		{
+			REQUIRE(seenTexts[i] == *corpus.getDocument(seen[i].docId));
+		}
+		std::ranges::sort(seen, {}, &RelDocFinder::RerankCandidate::docId);
+		REQUIRE(seen[0].docId == 0U);
+		REQUIRE(seen[0].length == 2U);
+		REQUIRE(seen[2].length == 1U);
+		REQUIRE(seen[2].score > seen[0].score);
+		REQUIRE(seen[4].score == 0.0);
+
+		// a depth of 0 leaves the first stage alone
+		options.rerankDepth = 0U;
+		REQUIRE(corpus.searchQuery("day", 1U, options)[0].docId == 2U);
+		REQUIRE(batches == 1U);
+	}
+
+	SECTION("Corpus with document fields")
+	{
+		RelDocFinder::Corpus fielded{ RelDocFinder::CorpusOptions{ .shardCount = 2U } };
+		const RelDocFinder::DocumentField doc10[] = { { "title", "happy day" }, { "body", "a long body about nothing much at all" } };
+		const RelDocFinder::DocumentField doc11[] = { { "title", "nothing" }, { "body", "happy happy" } };
+		REQUIRE(fielded.addDocument(10U, doc10));
+		REQUIRE(fielded.addDocument(11U, doc11));
+		REQUIRE(fielded.addDocument(12U, "sad day"));
+
+		REQUIRE(fielded.getDocument(10U) == "happy day a long body about nothing much at all");
+		REQUIRE(fielded.getField(10U, "title") == "happy day");
+		REQUIRE(fielded.getField(11U, "body") == "happy happy");
+		REQUIRE(!fielded.getField(10U, "tags"));
+		REQUIRE(!fielded.getField(12U, "title"));
+
+		// a plain word is scored by the whole document
+		RelDocFinder::QueryResult queryRes = fielded.searchQuery("happy", 2U);
+		REQUIRE(queryRes[0].docId == 11U);
+		REQUIRE(queryRes[0].score == Approx(2.0 / 3.0 * std::log10(1.5)));
+		REQUIRE(queryRes[1].score == Approx(1.0 / 10.0 * std::log10(1.5)));
+
+		// name:word only by its field, normed by the field's length
+		queryRes = fielded.searchQuery("title:happy", 3U);
+		REQUIRE(queryRes[0].docId == 10U);
+		REQUIRE(queryRes[0].score == Approx(1.0 / 2.0 * std::log10(3.0)));
+		REQUIRE(queryRes[1].score == 0.0);
+		REQUIRE(fielded.documentFrequency(RelDocFinder::CorpusShard::fieldTerm("body", "happy")) == 1U);
+
+		queryRes = fielded.searchQuery("title:happy body:happy", 2U);
+		REQUIRE(queryRes[0].docId == 11U);
+		REQUIRE(queryRes[0].score == Approx(std::log10(3.0)));
+		REQUIRE(queryRes[1].docId == 10U);
+
+		queryRes = fielded.searchQuery("+body:happy day", 3U);
+		REQUIRE(queryRes.size() == 1U);
+		REQUIRE(queryRes[0].docId == 11U);
+
+		// names are distinct, without ':' or ' ', and some field has text
+		const RelDocFinder::DocumentField colon[] = { { "ti:tle", "x" } };
+		const RelDocFinder::DocumentField twice[] = { { "title", "x" }, { "title", "y" } };
+		const RelDocFinder::DocumentField empty[] = { { "title", "" } };
+		REQUIRE(!fielded.addDocument(13U, colon));
+		REQUIRE(!fielded.addDocument(13U, twice));
+		REQUIRE(!fielded.addDocument(13U, empty));
+
+		// updates diff the field postings too, and a plain update drops the fields
+		const RelDocFinder::DocumentField sad[] = { { "title", "sad" }, { "body", "a long body about nothing much at all" } };
+		REQUIRE(fielded.updateDocument(10U, sad));
+		REQUIRE(fielded.searchQuery("+title:happy", 3U).empty());
+		REQUIRE(fielded.searchQuery("+title:sad", 3U)[0].docId == 10U);
+		REQUIRE(fielded.documentFrequency(RelDocFinder::CorpusShard::fieldTerm("title", "happy")) == 0U);
+
+		REQUIRE(fielded.updateDocument(11U, "happy"));
+		REQUIRE(!fielded.getField(11U, "body"));
+		REQUIRE(fielded.searchQuery("+body:happy", 3U).empty());
+		REQUIRE(fielded.documentFrequency(RelDocFinder::CorpusShard::fieldTerm("body", "happy")) == 0U);
+
+		REQUIRE(fielded.deleteDocument(10U));
+		fielded.purgeDeleted();
+		REQUIRE(fielded.documentFrequency(RelDocFinder::CorpusShard::fieldTerm("body", "nothing")) == 0U);
+		REQUIRE(fielded.searchQuery("+body:nothing", 3U).empty());
+		REQUIRE(fielded.addDocument(10U, doc10));
+		REQUIRE(fielded.searchQuery("title:happy", 1U)[0].score == Approx(1.0 / 2.0 * std::log10(3.0)));
+
+		// a text's word which merely looks like name:word is a plain word, it is searchable until the corpus has such a field
+		RelDocFinder::Corpus colliding{ RelDocFinder::CorpusOptions{ .shardCount = 2U } };
+		REQUIRE(colliding.addDocument(20U, "meet at 12:30 title:happy"));
+		REQUIRE(colliding.searchQuery("+title:happy", 3U)[0].docId == 20U);
+
+		// then it neither counts for the field nor matches it
+		const RelDocFinder::DocumentField happy[] = { { "title", "happy" } };
+		REQUIRE(colliding.addDocument(21U, happy));
+		REQUIRE(colliding.documentFrequency(RelDocFinder::CorpusShard::fieldTerm("title", "happy")) == 1U);
+		REQUIRE(colliding.documentFrequency("title:happy") == 1U);
+		queryRes = colliding.searchQuery("+title:happy", 3U);
+		REQUIRE(queryRes.size() == 1U);
+		REQUIRE(queryRes[0].docId == 21U);
+		REQUIRE(queryRes[0].score == Approx(std::log10(2.0)));
+		REQUIRE(colliding.searchQuery("title:happy", 3U)[1].score == 0.0);
+		REQUIRE(colliding.searchQuery("+12:30", 3U)[0].docId == 20U);
+		REQUIRE(colliding.searchQueries(std::vector<std::string_view>{ "+title:happy" }, 3U)[0][0].docId == 21U);
+	}
+
+	SECTION("CsvReader")
+	{
+		// a tiny buffer, so records straddle refills and outgrow it
+		std::istringstream input{ "1,\"a, b\",\"say \"\"hi\"\"\"\r\n2,\"multi\nline\",x\n\n4,ab\"c,d\"e\n3" };
+		RelDocFinder::CsvReader reader{ input, 4U };
+
+		const auto record = [&reader]()
+		{
+			return std::vector<std::string_view>(reader.fields().begin(), reader.fields().end());
+		};
+
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "1", "a, b", "say \"hi\"" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "2", "multi\nline", "x" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "4", "ab\"c", "d\"e" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "3" });
+		REQUIRE(reader.recordNumber() == 5U);
+		REQUIRE(!reader.readRecord());
+		REQUIRE(!reader.readRecord());
+
+		// a quote within an unquoted field is literal, it must not swallow the records after it
+		std::istringstream stray{ "1,a 12\" pizza\n2,\"b\"\"c\"d\n3,\"e\nf\"\n" };
+		RelDocFinder::CsvReader strayReader{ stray, 4U };
+		REQUIRE(strayReader.readRecord());
+		REQUIRE(strayReader.fields()[1] == "a 12\" pizza");
+		REQUIRE(strayReader.readRecord());
+		REQUIRE(strayReader.fields()[1] == "b\"cd");
+		REQUIRE(strayReader.readRecord());
+		REQUIRE(strayReader.fields()[1] == "e\nf");
+		REQUIRE(!strayReader.readRecord());
+
+		// a record longer than the maximum is skipped, even one whose quoted line breaks hide its end
+		std::istringstream oversized{ "1,ok\n2,a record far too long\n3,\"quoted\nand too long\"\n4,end" };
+		RelDocFinder::CsvReader boundedReader{ oversized, 4U, 8U };
+		REQUIRE(boundedReader.readRecord());
+		REQUIRE(boundedReader.fields()[1] == "ok");
+		REQUIRE(boundedReader.readRecord());
+		REQUIRE(boundedReader.fields()[1] == "end");
+		REQUIRE(boundedReader.recordNumber() == 4U);
+		REQUIRE(boundedReader.skippedRecords() == 2U);
+		REQUIRE(!boundedReader.readRecord());
+	}
+
+	SECTION("Corpus from csv with quotes and column mappings")
+	{
+		{
+			std::ofstream csv{ "csv_docs.txt", std::ios::binary };
+			csv << "id,title,body\n7,\"happy, day\",nice\n8,sad,\"long\nbody\"\nx,skip,me\n9\n10,\"\"\n";
+		}
+
+		// by default the rest of the record is the document, commas and all
+		RelDocFinder::Corpus plain{ "csv_docs.txt" };
+		REQUIRE(plain.statistics().documentCount() == 2U);
+		REQUIRE(plain.getDocument(7U) == "happy, day,nice");
+		REQUIRE(plain.getDocument(8U) == "sad,long\nbody");
+
+		RelDocFinder::Corpus joined{ "csv_docs.txt", {}, RelDocFinder::CsvColumns{ 0U, { { 2U, "" }, { 1U, "" } } } };
+		REQUIRE(joined.getDocument(7U) == "nice happy, day");
+		REQUIRE(joined.searchQuery("nice", 1U)[0].docId == 7U);
+
+		RelDocFinder::Corpus fielded{ "csv_docs.txt", {}, RelDocFinder::CsvColumns{ 0U, { { 1U, "title" }, { 2U, "body" } } } };
+		REQUIRE(fielded.statistics().documentCount() == 2U);
+		REQUIRE(fielded.getField(7U, "title") == "happy, day");
+		REQUIRE(fielded.getField(8U, "body") == "long\nbody");
+		REQUIRE(fielded.searchQuery("+title:sad", 2U)[0].docId == 8U);
+
+		std::remove("csv_docs.txt");
+	}
+
+	SECTION("Corpus::ingest")
+	{
+		// enough small batches to keep several tokenizing while the reader waits
+		std::string stream{ "id,text\n" };
+		for (int i{ 0 }; i < 3000; ++i)
+		{
+			stream += std::to_string(i) + (i % 3 == 0 ? ",\"fizz, common\"\n" : ",buzz common\n");
+		}
+		stream += "7,\"updated\"\n";
+
+		RelDocFinder::Corpus ingested{ RelDocFinder::CorpusOptions{ .executorThreads = 2U, .shardCount = 3U } };
+		REQUIRE(ingested.addDocument(5000U, "fizz, already here"));
+
+		std::istringstream input{ stream };
+		REQUIRE(ingested.ingest(input, RelDocFinder::IngestOptions{ .batchSize = 64U, .maxBatchesInFlight = 2U }) == 3001U);
+		REQUIRE(ingested.statistics().documentCount() == 3001U);
+		REQUIRE(ingested.documentFrequency("fizz,") == 1001U);
+		REQUIRE(ingested.getDocument(2999U) == "buzz common");
+
+		// the later record of an id wins
+		REQUIRE(ingested.getDocument(7U) == "updated");
+		REQUIRE(ingested.searchQuery("updated", 1U)[0].docId == 7U);
+
+		std::istringstream fields{ "1,happy,day\n2,sad,night\n" };
+		const RelDocFinder::IngestOptions byField{ .columns = RelDocFinder::CsvColumns{ 0U, { { 1U, "title" }, { 2U, "body" } } } };
+		REQUIRE(ingested.ingest(fields, byField) == 2U);
+		REQUIRE(ingested.getField(2U, "body") == "night");
+		REQUIRE(ingested.searchQuery("+title:happy", 5U)[0].docId == 1U);
+
+		std::istringstream nothing{ "" };
+		REQUIRE(ingested.ingest(nothing) == 0U);
+	}
+
+	SECTION("JsonlReader")
+	{
+		std::istringstream input{ R"({"id": 1, "text": "say \"hi\"\né😀 and a text long enough for a vector scan", "skip": {"a": [1, "x\"}"]}}
+
+{"skip":"a,b", "text":"second" ,"id":"2"}
+not json
+{"id":3}
+{"id": 4, "text": null}
+{"id": 5, "text": 12}
+{"id": true, "text": {"a": "b"}})" };
+		RelDocFinder::JsonlReader reader{ input, RelDocFinder::JsonlKeys{}, 8U };
+
+		const auto record = [&reader]()
+		{
+			return std::vector<std::string_view>(reader.fields().begin(), reader.fields().end());
+		};
+
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "1", "say \"hi\"\n\xC3\xA9\xF0\x9F\x98\x80 and a text long enough for a vector scan" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "2", "second" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "", "" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "3", "" });
+
+		// only the id may be a number, any other value than a string is missing
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "4", "" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "5", "" });
+		REQUIRE(reader.readRecord());
+		REQUIRE(record() == std::vector<std::string_view>{ "", "" });
+		REQUIRE(!reader.readRecord());
+
+		// a line longer than the maximum is skipped, the last one without a LF too
+		std::istringstream oversized{ "{\"id\":1,\"text\":\"ok\"}\n{\"id\":2,\"text\":\"a line far too long\"}\n{\"id\":3,\"text\":\"end\"}\n{\"id\":4,\"text\":\"too long as well\"}" };
+		RelDocFinder::JsonlReader boundedReader{ oversized, RelDocFinder::JsonlKeys{}, 16U, 24U };
+		REQUIRE(boundedReader.readRecord());
+		REQUIRE(boundedReader.fields()[1] == "ok");
+		REQUIRE(boundedReader.readRecord());
+		REQUIRE(boundedReader.fields()[1] == "end");
+		REQUIRE(!boundedReader.readRecord());
+		REQUIRE(boundedReader.skippedRecords() == 2U);
+	}
+
+	SECTION("Corpus::ingest from jsonl")
+	{
+		const std::string stream{ "{\"id\":10,\"title\":\"happy day\",\"body\":\"nice, very\"}\n{\"id\":11,\"title\":\"sad\",\"body\":\"x\"}\n{\"id\":\"bad\",\"title\":\"y\"}\n" };
+
+		RelDocFinder::Corpus plain{ RelDocFinder::CorpusOptions{ .executorThreads = 1U, .shardCount = 2U } };
+		std::istringstream text{ "{\"id\":4,\"text\":\"happy\"}\n{\"text\":\"no id\"}\n{\"id\":5,\"text\":null}\n{\"id\":6,\"text\":7}\n" };
+		REQUIRE(plain.ingest(text, RelDocFinder::IngestOptions{ .format = RelDocFinder::IngestFormat::jsonl }) == 1U);
+		REQUIRE(plain.getDocument(4U) == "happy");
+
+		std::istringstream joined{ stream };
+		RelDocFinder::IngestOptions options{ .format = RelDocFinder::IngestFormat::jsonl };
+		options.keys.textKeys = { { "title", "" }, { "body", "" } };
+		REQUIRE(plain.ingest(joined, options) == 2U);
+		REQUIRE(plain.getDocument(10U) == "happy day nice, very");
+
+		RelDocFinder::Corpus fielded{ RelDocFinder::CorpusOptions{ .executorThreads = 1U, .shardCount = 2U } };
+		std::istringstream fields{ stream };
+		options.keys.textKeys = { { "title", "title" }, { "body", "body" } };
+		REQUIRE(fielded.ingest(fields, options) == 2U);
+		REQUIRE(fielded.getField(10U, "body") == "nice, very");
+		REQUIRE(fielded.searchQuery("+title:sad", 2U)[0].docId == 11U);
+
+		// a read which throws leaves only once the batches still tokenizing are done with the columns
+		std::string lines{};
+		for (int i{ 0 }; i < 2000; ++i)
+		{
+			lines += "{\"id\":" + std::to_string(100 + i) + ",\"title\":\"t\",\"body\":\"some body text\"}\n";
+		}
+		FailingBuffer failing{ std::move(lines) };
+		std::istream failingInput{ &failing };
+		failingInput.exceptions(std::ios::badbit);
+		options.batchSize = 16U;
+		options.maxBatchesInFlight = 8U;
+		REQUIRE_THROWS_AS(fielded.ingest(failingInput, options), std::runtime_error);
+		REQUIRE(fielded.searchQuery("+title:sad", 2U)[0].docId == 11U);
+	}
+
+	SECTION("Lz77")
+	{
+		std::mt19937 rng{ 49U };
+		std::string random(100000U, '\0');
+		std::ranges::generate(random, [&rng]() { return static_cast<char>(rng()); });
+
+		std::string repetitive{};
+		for (int i{ 0 }; i < 5000; ++i)
+		{
+			repetitive += "document " + std::to_string(i % 97) + " of the corpus, ";
+		}
+
+		for (const std::string_view input : { std::string_view{}, std::string_view{ "a" }, std::string_view{ "aaaaaaaaaaaaaaaaaaaa" },
+			std::string_view{ "abcdabcdabcdx" }, std::string_view{ random }, std::string_view{ repetitive } })
+		{
+			const std::vector<std::uint8_t> compressed{ RelDocFinder::Lz77::compress(input) };
+			REQUIRE(RelDocFinder::Lz77::decompress(compressed, std::size(input)) == input);
+		}
+
+		REQUIRE(RelDocFinder::Lz77::compress(repetitive).size() * 10U < repetitive.size());
+		REQUIRE(RelDocFinder::Lz77::compress(random).size() < random.size() + random.size() / 100U);
+	}
+
+	SECTION("DocumentStore")
+	{
+		// texts of 35 bytes, so blocks of 100 bytes seal every third
+		const auto text = [](const int i)
+		{
+			return std::make_shared<const std::string>("text number " + std::to_string(i) + " padded to some length");
+		};
+
+		RelDocFinder::DocumentStore store{ 100U, 4U };
+		for (int i{ 0 }; i < 9; ++i)
+		{
+			store.insert(static_cast<RelDocFinder::DocId>(i), text(i));
+		}
+
+		// a text of the open block is the one given, a sealed one views its cached block
+		const std::shared_ptr<const std::string> open{ text(9) };
+		store.insert(9U, open);
+		REQUIRE(store.find(9U)->view().data() == open->data());
+		REQUIRE(store.find(4U) == *text(4));
+		REQUIRE(store.find(5U) == *text(5));
+		const RelDocFinder::DocumentStoreStats sealed{ store.stats() };
+		REQUIRE(sealed.blockMisses == 1U);
+		REQUIRE(sealed.blockHits == 1U);
+
+		// a block whose every text is gone is dropped without decompressing it
+		for (const RelDocFinder::DocId docId : { 0U, 1U, 2U })
+		{
+			REQUIRE(store.erase(docId));
+		}
+		REQUIRE(store.stats().storedBytes < sealed.storedBytes);
+		REQUIRE(store.compactableBlocks() == 0U);
+
+		// one left mostly dead is only queued, until compact moves its live text to the open block
+		REQUIRE(store.erase(3U));
+		REQUIRE(store.erase(4U));
+		REQUIRE(store.stats().blockMisses == sealed.blockMisses);
+		REQUIRE(store.compactableBlocks() == 1U);
+		REQUIRE(store.compact() == 1U);
+		REQUIRE(store.compactableBlocks() == 0U);
+		REQUIRE(store.find(5U) == *text(5));
+		REQUIRE(!store.find(4U));
+		REQUIRE(store.stats().documentBytes == 5U * 35U);
+
+		// without blocks a text is always the one given
+		RelDocFinder::DocumentStore plain{ 0U, 0U };
+		plain.insert(1U, open);
+		REQUIRE(plain.find(1U)->view().data() == open->data());
+	}
+
+	SECTION("Corpus with compressed documents")
+	{
+		RelDocFinder::Corpus compressed{ RelDocFinder::CorpusOptions{ .shardCount = 2U, .indexPositions = true, .documentBlockBytes = 512U, .documentCacheBlocks = 2U } };
+		const auto text = [](const int i)
+		{
+			return "document " + std::to_string(i) + " mentions word" + std::to_string(i % 10) + " among the usual filler words of the corpus";
+		};
+
+		for (int i{ 0 }; i < 1000; ++i)
+		{
+			REQUIRE(compressed.addDocument(static_cast<RelDocFinder::DocId>(i), text(i)));
+		}
+
+		const RelDocFinder::DocumentStoreStats stats{ compressed.documentStoreStats() };
+		REQUIRE(stats.storedBytes * 3U < stats.documentBytes);
+
+		REQUIRE(compressed.getDocument(0U) == text(0));
+		REQUIRE(compressed.getDocument(999U) == text(999));
+		REQUIRE(!compressed.getDocument(1000U));
+
+		// a re-ranker which reads no text leaves all but the kept hit compressed
+		const RelDocFinder::DocumentStoreStats beforeRerank{ compressed.documentStoreStats() };
+		RelDocFinder::QueryOptions proximity{};
+		proximity.rerankDepth = 50U;
+		proximity.reranker = RelDocFinder::proximityReranker();
+		REQUIRE(compressed.searchQuery("filler word3", 1U, proximity).size() == 1U);
+		const RelDocFinder::DocumentStoreStats afterRerank{ compressed.documentStoreStats() };
+		REQUIRE(afterRerank.blockHits + afterRerank.blockMisses - beforeRerank.blockHits - beforeRerank.blockMisses <= 1U);
+
+		// only the hits are decompressed, and their texts stay pinned when the documents go
+		RelDocFinder::QueryResult queryRes = compressed.searchQuery("word7", 5U);
+		REQUIRE(queryRes.size() == 5U);
+		const std::optional<RelDocFinder::PinnedText> pinned0{ compressed.getDocument(0U) };
+		const std::optional<RelDocFinder::PinnedText> pinned1{ compressed.getDocument(1U) };
+		const std::uint64_t missesBeforeWrites{ compressed.documentStoreStats().blockMisses };
+		for (int i{ 0 }; i < 1000; i += 2)
+		{
+			REQUIRE(compressed.deleteDocument(static_cast<RelDocFinder::DocId>(i)));
+		}
+		for (int i{ 1 }; i < 1000; i += 4)
+		{
+			REQUIRE(compressed.updateDocument(static_cast<RelDocFinder::DocId>(i), "updated " + text(i)));
+		}
+		for (const RelDocFinder::QueryHit& hit : queryRes)
+		{
+			REQUIRE(hit.text == text(static_cast<int>(hit.docId)));
+		}
+		REQUIRE(pinned0 == text(0));
+		REQUIRE(pinned1 == text(1));
+		REQUIRE(compressed.documentStoreStats().blockMisses > 0U);
+
+		// deletes and updates never decompress, the purge compacts mostly dead blocks, and every live text survives it
+		REQUIRE(compressed.documentStoreStats().blockMisses == missesBeforeWrites);
+		compressed.purgeDeleted();
+		REQUIRE(compressed.documentStoreStats().storedBytes < stats.storedBytes);
+		for (int i{ 1 }; i < 1000; i += 2)
+		{
+			REQUIRE(compressed.getDocument(static_cast<RelDocFinder::DocId>(i)) == (i % 4 == 1 ? "updated " : "") + text(i));
+		}
+		REQUIRE(compressed.searchQuery("+updated +word3", 1000U).size() == 50U);
+		REQUIRE(compressed.searchQuery("\"mentions word3\"", 1000U).size() == 100U);
+
+		const RelDocFinder::DocumentField fields[] = { { "title", "compressed title" }, { "body", "and its body" } };
+		REQUIRE(compressed.addDocument(5000U, fields));
+		REQUIRE(compressed.getField(5000U, "body") == "and its body");
+	}
+
+	SECTION("Corpus without stored documents")
+	{
+		RelDocFinder::Corpus indexOnly{ "init_docs.txt", RelDocFinder::CorpusOptions{ .shardCount = 2U, .storeDocuments = false } };
+
+		// ranks exactly like a corpus with the texts, but finds no text
+		const RelDocFinder::QueryResult expected = corpus.searchQuery("happy day", 5U);
+		const RelDocFinder::QueryResult queryRes = indexOnly.searchQuery("happy day", 5U);
+		REQUIRE(queryRes.size() == expected.size());
+		for (std::size_t i{ 0U }; i < queryRes.size(); ++i)
+		{
+			REQUIRE(queryRes[i].docId == expected[i].docId);
+			REQUIRE(queryRes[i].score == expected[i].score);
+			REQUIRE(queryRes[i].text.empty());
+		}
+		REQUIRE(!indexOnly.getDocument(0U));
+		REQUIRE(indexOnly.documentStoreStats().storedBytes == 0U);
+
+		const RelDocFinder::DocId ids[] = { 0U, 1U };
+		REQUIRE(std::ranges::all_of(indexOnly.fetchDocuments(ids), [](const auto& doc) { return !doc; }));
+
+		// updates still diff against the bags, which live on without the texts
+		REQUIRE(indexOnly.updateDocument(0U, "sad day"));
+		REQUIRE(indexOnly.documentFrequency("happy") == 1U);
+		REQUIRE(indexOnly.searchQuery("+sad", 5U)[0].docId == 0U);
+		REQUIRE(indexOnly.deleteDocument(2U));
+		REQUIRE(indexOnly.documentFrequency("day") == 2U);
+
+		const RelDocFinder::DocumentField fields[] = { { "title", "no text" }, { "body", "kept anywhere" } };
+		REQUIRE(indexOnly.addDocument(10U, fields));
+		REQUIRE(!indexOnly.getField(10U, "title"));
+		REQUIRE(indexOnly.searchQuery("+body:kept", 5U)[0].docId == 10U);
+		const RelDocFinder::DocumentField updated[] = { { "title", "no text" }, { "body", "kept elsewhere" } };
+		REQUIRE(indexOnly.updateDocument(10U, updated));
+		REQUIRE(indexOnly.searchQuery("+body:kept -body:anywhere", 5U)[0].docId == 10U);
+
+		RelDocFinder::QueryOptions options{};
+		options.rerankDepth = 10U;
+		options.reranker = [](std::span<RelDocFinder::RerankCandidate> candidates, const RelDocFinder::RerankContext& context)
+		{
+			REQUIRE(std::ranges::all_of(candidates, [&context](const RelDocFinder::RerankCandidate& candidate) { return context.documentText(candidate.docId).empty(); }));
+		};
+		REQUIRE(indexOnly.searchQuery("day", 2U, options).size() == 2U);
 	}
-}
\ No newline at end of file
+}
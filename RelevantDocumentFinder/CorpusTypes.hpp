@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+namespace RelDocFinder
+{
+	using ulong = unsigned long;
+	using DocId = ulong;
+
+	// dense, corpus-internal index of a document, used to address flat per-document arrays
+	using DocOrdinal = std::uint32_t;
+
+	// #(occurences of a word in a document)
+	using Frequency = std::uint32_t;
+
+	// a named part of a document, such as its title or body
+	struct DocumentField
+	{
+		std::string_view name;
+		std::string_view text;
+	};
+
+	// a view into a document's text which keeps the text alive, even if the document is deleted, updated or evicted from a cache meanwhile
+	class PinnedText
+	{
+	public:
+		PinnedText(std::shared_ptr<const std::string> document, std::string_view text) noexcept : document_{ std::move(document) }, text_{ text }
+		{
+		}
+
+		[[nodiscard]] std::string_view view() const noexcept { return text_; }
+
+		operator std::string_view() const noexcept { return text_; }
+
+		// a part of the text, pinning the same document
+		[[nodiscard]] PinnedText substr(const std::size_t offset, const std::size_t length) const noexcept { return { document_, text_.substr(offset, length) }; }
+
+		friend bool operator==(const PinnedText& pinned, std::string_view text) noexcept { return pinned.text_ == text; }
+
+	private:
+		std::shared_ptr<const std::string> document_;
+		std::string_view text_;			// into *document_
+	};
+
+	struct string_view_hash
+	{
+		using is_transparent = std::true_type;
+
+		auto operator()(std::string_view sv) const noexcept
+		{
+			return std::hash<std::string_view>()(sv);
+		}
+	};
+
+	struct string_view_equal
+	{
+		using is_transparent = std::true_type;
+
+		bool operator()(std::string_view a, std::string_view b) const noexcept
+		{
+			return a == b;
+		}
+	};
+}
@@ -0,0 +1,178 @@
+#include "CsvReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+
+namespace RelDocFinder
+{
+	CsvReader::CsvReader(std::istream& input, const std::size_t bufferBytes, const std::size_t maxRecordBytes)
+		: input_{ input }, buffer_(std::max<std::size_t>(bufferBytes, 16U)), maxRecordBytes_{ std::max<std::size_t>(maxRecordBytes, 1U) }
+	{
+	}
+
+	bool CsvReader::readRecord()
+	{
+		fields_.clear();
+
+		while (true)
+		{
+			std::size_t end{ findRecordEnd() };
+			while (end == end_ && !exhausted_)
+			{
+				// the scanned part of an oversized record is dropped, only its end is still looked for
+				if (end_ - begin_ >= maxRecordBytes_) [[unlikely]]
+				{
+					begin_ = end_;
+					oversized_ = true;
+				}
+
+				refill();
+				end = findRecordEnd();
+			}
+
+			const bool oversized{ std::exchange(oversized_, false) };
+			if (begin_ == end_ && !oversized) [[unlikely]]
+			{
+				return false;
+			}
+
+			if (!oversized) [[likely]]
+			{
+				splitRecord(end);
+			}
+			begin_ = end;
+			scanned_ = end;
+			scanState_ = ScanState::fieldStart;
+			++recordNumber_;
+
+			if (!oversized) [[likely]]
+			{
+				return true;
+			}
+			++skippedRecords_;
+		}
+	}
+
+	std::size_t CsvReader::findRecordEnd() noexcept
+	{
+		for (; scanned_ < end_; ++scanned_)
+		{
+			const char c{ buffer_[scanned_] };
+			switch (scanState_)
+			{
+			case ScanState::quoted:
+				if (c == '"')
+				{
+					scanState_ = ScanState::quoteInQuoted;
+				}
+				continue;
+
+			case ScanState::quoteInQuoted:
+				if (c == '"')
+				{
+					scanState_ = ScanState::quoted;
+					continue;
+				}
+				break;
+
+			case ScanState::fieldStart:
+				if (c == '"')
+				{
+					scanState_ = ScanState::quoted;
+					continue;
+				}
+				break;
+
+			case ScanState::unquoted:
+				break;
+			}
+
+			if (c == '\n')
+			{
+				return scanned_ + 1U;
+			}
+			scanState_ = c == ',' ? ScanState::fieldStart : ScanState::unquoted;
+		}
+		return end_;
+	}
+
+	void CsvReader::refill()
+	{
+		if (begin_ != 0U)
+		{
+			std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+			end_ -= begin_;
+			scanned_ -= begin_;
+			begin_ = 0U;
+		}
+
+		if (end_ == std::size(buffer_))
+		{
+			buffer_.resize(2U * std::size(buffer_));
+		}
+
+		input_.read(buffer_.data() + end_, static_cast<std::streamsize>(std::size(buffer_) - end_));
+		const std::size_t read{ static_cast<std::size_t>(input_.gcount()) };
+		end_ += read;
+		exhausted_ = read == 0U;
+	}
+
+	void CsvReader::splitRecord(const std::size_t end) noexcept
+	{
+		// unescaping only ever shrinks a field, so it is written over the record as it is read
+		char* const data{ buffer_.data() };
+		std::size_t out{ begin_ };
+		std::size_t fieldStart{ begin_ };
+		std::size_t fieldIn{ begin_ };					// where the field starts in the input, only a quote there opens it
+		bool quoted{ false };
+
+		for (std::size_t in{ begin_ }; in < end; ++in)
+		{
+			const char c{ data[in] };
+			if (quoted)
+			{
+				if (c != '"')
+				{
+					data[out++] = c;
+				}
+				else if (in + 1U < end && data[in + 1U] == '"')
+				{
+					data[out++] = '"';
+					++in;
+				}
+				else
+				{
+					quoted = false;
+				}
+				continue;
+			}
+
+			if (c == '"' && in == fieldIn)
+			{
+				quoted = true;
+				continue;
+			}
+
+			// the comma stays, so neighbouring fields can still be viewed as the columns they were
+			if (c == ',')
+			{
+				fields_.emplace_back(data + fieldStart, out - fieldStart);
+				data[out++] = ',';
+				fieldStart = out;
+				fieldIn = in + 1U;
+				continue;
+			}
+
+			if (c == '\n' || (c == '\r' && in + 1U < end && data[in + 1U] == '\n'))
+			{
+				break;
+			}
+
+			data[out++] = c;
+		}
+
+		fields_.emplace_back(data + fieldStart, out - fieldStart);
+	}
+}
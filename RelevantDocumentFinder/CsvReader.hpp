@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// a text column of a csv record, named to make it a field of the document
+	struct CsvTextColumn
+	{
+		std::size_t column;
+		std::string field;
+	};
+
+	// how the columns of a csv record map to a document
+	struct CsvColumns
+	{
+		std::size_t idColumn{ 0U };
+
+		// every column is a field if every one is named, else they are joined by spaces into a plain document
+		// none takes every column after the id column, joined by the commas they were split on
+		std::vector<CsvTextColumn> textColumns{};
+	};
+
+
+	// streams RFC 4180 records: fields split by commas, records by LF or CRLF,
+	// and quoted fields may hold commas, line breaks and quotes doubled as ""
+	// only a quote opening a field starts quoting, any other quote outside a quoted field is a literal character,
+	// so a stray quote such as 12" stays within its field, but an unclosed quoted field runs to the end of the input
+	class CsvReader
+	{
+	public:
+		// a record of more than maxRecordBytes is skipped, so the buffer never grows past about twice that
+		explicit CsvReader(std::istream& input, const std::size_t bufferBytes = 64U * 1024U, const std::size_t maxRecordBytes = 64U * 1024U * 1024U);
+
+		// false once the input is exhausted, a blank line is a record of one empty field
+		[[nodiscard]] bool readRecord();
+
+		// the fields of the last record read, unescaped in place in the reader's buffer until the next readRecord
+		[[nodiscard]] std::span<const std::string_view> fields() const noexcept { return fields_; }
+
+		// 1 for the first record
+		// skipped records are numbered too
+		[[nodiscard]] std::size_t recordNumber() const noexcept { return recordNumber_; }
+
+		// #(records skipped for exceeding maxRecordBytes)
+		[[nodiscard]] std::size_t skippedRecords() const noexcept { return skippedRecords_; }
+
+	private:
+		enum class ScanState : std::uint8_t
+		{
+			fieldStart,
+			unquoted,
+			quoted,
+			quoteInQuoted		// either closes the field or is the first of ""
+		};
+
+		std::istream& input_;
+		std::vector<char> buffer_;
+		std::size_t begin_{ 0U };				// the unread records start here
+		std::size_t end_{ 0U };					// the buffered input ends here
+		bool exhausted_{ false };
+		std::size_t maxRecordBytes_;
+
+		// how far the record at begin_ was scanned for its end, so a refill does not rescan it
+		std::size_t scanned_{ 0U };
+		ScanState scanState_{ ScanState::fieldStart };
+		bool oversized_{ false };				// the record at begin_ is being skipped, its start is already dropped
+
+		std::vector<std::string_view> fields_;
+		std::size_t recordNumber_{ 0U };
+		std::size_t skippedRecords_{ 0U };
+
+
+		// the end of the record at begin_, past its LF, or end_ if the buffer ends first
+		[[nodiscard]] std::size_t findRecordEnd() noexcept;
+
+		// moves the unread input to the front of the buffer, growing it if the record fills it, and reads more
+		void refill();
+
+		// splits and unescapes the record [begin_, end)
+		void splitRecord(const std::size_t end) noexcept;
+	};
+}
@@ -0,0 +1,236 @@
+#include "DocumentStore.hpp"
+#include "Lz77.hpp"
+
+#include <utility>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	DocumentStore::DocumentStore(const std::size_t blockBytes, const std::size_t cacheBlocks)
+		: blockBytes_{ blockBytes }, cacheBlocks_{ cacheBlocks }
+	{
+	}
+
+	void DocumentStore::insert(const DocId docId, std::shared_ptr<const std::string> text) noexcept
+	{
+		erase(docId);
+		append(docId, std::move(text));
+	}
+
+	bool DocumentStore::erase(const DocId docId) noexcept
+	{
+		if (const auto it = docIdToText_.find(docId); it != docIdToText_.end())
+		{
+			documentBytes_ -= std::size(*it->second);
+			if (blockBytes_ != 0U)
+			{
+				openBytes_ -= std::size(*it->second);
+			}
+			docIdToText_.erase(it);
+			return true;
+		}
+
+		const auto it = docIdToLocation_.find(docId);
+		if (it == docIdToLocation_.end())
+		{
+			return false;
+		}
+
+		const Location location{ it->second };
+		docIdToLocation_.erase(it);
+		release(location);
+		return true;
+	}
+
+	std::optional<PinnedText> DocumentStore::find(const DocId docId) const noexcept
+	{
+		if (const auto it = docIdToText_.find(docId); it != docIdToText_.end())
+		{
+			return PinnedText{ it->second, *it->second };
+		}
+
+		const auto it = docIdToLocation_.find(docId);
+		if (it == docIdToLocation_.end())
+		{
+			return { };
+		}
+
+		const Location location{ it->second };
+		std::shared_ptr<const std::string> raw{ decompressed(location.block) };
+		const std::string_view text{ std::string_view{ *raw }.substr(location.offset, location.length) };
+		return PinnedText{ std::move(raw), text };
+	}
+
+	std::size_t DocumentStore::compact() noexcept
+	{
+		std::size_t compacted{ 0U };
+		for (const std::uint32_t blockIdx : std::exchange(compactable_, {}))
+		{
+			Block& block{ blocks_[blockIdx] };
+			block.queued = false;
+
+			const std::string raw{ Lz77::decompress(block.compressed, block.rawBytes) };
+
+			// the live texts leave the block before it is dropped, so sealing them anew can reuse its slot
+			std::vector<std::pair<DocId, std::shared_ptr<const std::string>>> live{};
+			for (const DocId docId : block.docIds)
+			{
+				const auto it = docIdToLocation_.find(docId);
+				if (it == docIdToLocation_.end() || it->second.block != blockIdx)
+				{
+					continue;
+				}
+
+				live.emplace_back(docId, std::make_shared<const std::string>(raw, it->second.offset, it->second.length));
+				documentBytes_ -= it->second.length;
+				docIdToLocation_.erase(it);
+			}
+
+			drop(blockIdx);
+			for (auto& [docId, text] : live)
+			{
+				append(docId, std::move(text));
+			}
+			++compacted;
+		}
+		return compacted;
+	}
+
+	DocumentStoreStats DocumentStore::stats() const noexcept
+	{
+		std::size_t storedBytes{ documentBytes_ };
+		if (blockBytes_ != 0U)
+		{
+			storedBytes = compressedBytes_ + openBytes_;
+		}
+
+		return { documentBytes_, storedBytes, blockHits_.load(std::memory_order_relaxed), blockMisses_.load(std::memory_order_relaxed) };
+	}
+
+	void DocumentStore::append(const DocId docId, std::shared_ptr<const std::string> text) noexcept
+	{
+		documentBytes_ += std::size(*text);
+		if (blockBytes_ != 0U)
+		{
+			openBytes_ += std::size(*text);
+		}
+		docIdToText_.insert_or_assign(docId, std::move(text));
+
+		if (blockBytes_ != 0U && openBytes_ >= blockBytes_)
+		{
+			seal();
+		}
+	}
+
+	void DocumentStore::seal() noexcept
+	{
+		std::uint32_t blockIdx{ static_cast<std::uint32_t>(std::size(blocks_)) };
+		if (!freeBlocks_.empty())
+		{
+			blockIdx = freeBlocks_.back();
+			freeBlocks_.pop_back();
+		}
+
+		std::string raw{};
+		raw.reserve(openBytes_);
+		std::vector<DocId> docIds{};
+		docIds.reserve(std::size(docIdToText_));
+		for (const auto& [docId, text] : docIdToText_)
+		{
+			docIdToLocation_.insert_or_assign(docId,
+				Location{ blockIdx, static_cast<std::uint32_t>(std::size(raw)), static_cast<std::uint32_t>(std::size(*text)) });
+			raw.append(*text);
+			docIds.push_back(docId);
+		}
+
+		Block block{ Lz77::compress(raw), static_cast<std::uint32_t>(std::size(raw)), static_cast<std::uint32_t>(std::size(raw)), std::move(docIds), false };
+		block.compressed.shrink_to_fit();
+		compressedBytes_ += std::size(block.compressed);
+		if (blockIdx == std::size(blocks_))
+		{
+			blocks_.push_back(std::move(block));
+		}
+		else
+		{
+			blocks_[blockIdx] = std::move(block);
+		}
+
+		docIdToText_.clear();
+		openBytes_ = 0U;
+	}
+
+	void DocumentStore::release(const Location location) noexcept
+	{
+		documentBytes_ -= location.length;
+
+		Block& block{ blocks_[location.block] };
+		block.liveBytes -= location.length;
+		if (block.liveBytes == 0U)
+		{
+			drop(location.block);
+		}
+		else if (!block.queued && block.liveBytes < block.rawBytes / 2U)
+		{
+			block.queued = true;
+			compactable_.push_back(location.block);
+		}
+	}
+
+	void DocumentStore::drop(const std::uint32_t blockIdx) noexcept
+	{
+		if (blocks_[blockIdx].queued)
+		{
+			std::erase(compactable_, blockIdx);
+		}
+		compressedBytes_ -= std::size(blocks_[blockIdx].compressed);
+		blocks_[blockIdx] = Block{ {}, 0U, 0U, {}, false };
+		freeBlocks_.push_back(blockIdx);
+
+		std::scoped_lock lock{ cacheMutex_ };
+		if (const auto it = cacheIndex_.find(blockIdx); it != cacheIndex_.end())
+		{
+			cached_.erase(it->second);
+			cacheIndex_.erase(it);
+		}
+	}
+
+	std::shared_ptr<const std::string> DocumentStore::decompressed(const std::uint32_t blockIdx) const noexcept
+	{
+		{
+			std::scoped_lock lock{ cacheMutex_ };
+			if (const auto it = cacheIndex_.find(blockIdx); it != cacheIndex_.end())
+			{
+				blockHits_.fetch_add(1U, std::memory_order_relaxed);
+				cached_.splice(cached_.begin(), cached_, it->second);
+				return it->second->second;
+			}
+		}
+
+		// decompressed outside the lock, so readers of other blocks are not held up
+		blockMisses_.fetch_add(1U, std::memory_order_relaxed);
+		const Block& block{ blocks_[blockIdx] };
+		std::shared_ptr<const std::string> raw{ std::make_shared<const std::string>(Lz77::decompress(block.compressed, block.rawBytes)) };
+
+		if (cacheBlocks_ == 0U)
+		{
+			return raw;
+		}
+
+		std::scoped_lock lock{ cacheMutex_ };
+		if (cacheIndex_.contains(blockIdx))
+		{
+			return raw;
+		}
+
+		if (std::size(cached_) == cacheBlocks_)
+		{
+			cacheIndex_.erase(cached_.back().first);
+			cached_.pop_back();
+		}
+
+		cached_.emplace_front(blockIdx, raw);
+		cacheIndex_.emplace(blockIdx, cached_.begin());
+		return raw;
+	}
+}
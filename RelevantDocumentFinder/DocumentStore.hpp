@@ -0,0 +1,111 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	struct DocumentStoreStats
+	{
+		std::size_t documentBytes;		// the texts of the documents stored
+		std::size_t storedBytes;		// what holding them takes, compressed blocks included whole
+		std::uint64_t blockHits;
+		std::uint64_t blockMisses;
+	};
+
+
+	// the texts of a shard's documents
+	// without blocks each text is kept as it was given, else texts are packed into blocks of about blockBytes,
+	// each compressed once full, and an LRU cache keeps the last cacheBlocks blocks read decompressed
+	// a block is dropped once none of its texts lives, one left mostly dead is only queued for compact, so writes never decompress
+	// writes need the owner's exclusive lock, finds may run concurrently under its shared lock
+	class DocumentStore
+	{
+	public:
+		DocumentStore(const std::size_t blockBytes, const std::size_t cacheBlocks);
+
+		// replaces the text of a document already stored
+		void insert(const DocId docId, std::shared_ptr<const std::string> text) noexcept;
+
+		bool erase(const DocId docId) noexcept;
+
+		// pins the text as it was given, or the decompressed block it lies in, so it stays valid whatever is written later
+		[[nodiscard]] std::optional<PinnedText> find(const DocId docId) const noexcept;
+
+		// moves the live texts of the queued mostly dead blocks to the open block and frees their slots, returns #(blocks compacted)
+		std::size_t compact() noexcept;
+
+		// #(blocks queued for compact)
+		[[nodiscard]] std::size_t compactableBlocks() const noexcept { return std::size(compactable_); }
+
+		[[nodiscard]] DocumentStoreStats stats() const noexcept;
+
+	private:
+		struct Location
+		{
+			std::uint32_t block;
+			std::uint32_t offset;
+			std::uint32_t length;
+		};
+
+		struct Block
+		{
+			std::vector<std::uint8_t> compressed;
+			std::uint32_t rawBytes;
+			std::uint32_t liveBytes;				// the bytes of the texts which still live here
+			std::vector<DocId> docIds;				// every document placed here, live or not
+			bool queued;							// in compactable_
+		};
+
+		using CachedBlock = std::pair<std::uint32_t, std::shared_ptr<const std::string>>;
+
+		// most recently used first
+		using CachedBlocks = std::list<CachedBlock>;
+
+
+		std::size_t blockBytes_;
+		std::size_t cacheBlocks_;
+
+		// without blocks every text, else the texts of the open block, which is compressed once they fill it
+		std::unordered_map<DocId, std::shared_ptr<const std::string>> docIdToText_;
+		std::size_t openBytes_{ 0U };
+
+		std::unordered_map<DocId, Location> docIdToLocation_;
+		std::vector<Block> blocks_;					// sealed blocks, a dropped one is left empty with its slot in freeBlocks_
+		std::vector<std::uint32_t> freeBlocks_;
+		std::vector<std::uint32_t> compactable_;
+		std::size_t documentBytes_{ 0U };
+		std::size_t compressedBytes_{ 0U };
+
+		mutable CachedBlocks cached_;
+		mutable std::unordered_map<std::uint32_t, CachedBlocks::iterator> cacheIndex_;
+		mutable std::mutex cacheMutex_;
+		mutable std::atomic<std::uint64_t> blockHits_{ 0U };
+		mutable std::atomic<std::uint64_t> blockMisses_{ 0U };
+
+
+		void append(const DocId docId, std::shared_ptr<const std::string> text) noexcept;
+
+		void seal() noexcept;
+
+		// the text of a document which no longer lives at location
+		void release(const Location location) noexcept;
+
+		// empties the block and frees its slot, evicting it from the cache so the slot's next block is never mistaken for it
+		void drop(const std::uint32_t block) noexcept;
+
+		std::shared_ptr<const std::string> decompressed(const std::uint32_t block) const noexcept;
+	};
+}
@@ -0,0 +1,100 @@
+#include "Executor.hpp"
+
+#include <algorithm>
+#include <memory>
+
+
+namespace RelDocFinder
+{
+	Executor::Executor(const std::size_t nThreads)
+	{
+		workers_.reserve(std::max<std::size_t>(nThreads, 1U));
+		for (std::size_t i{ 0U }; i < std::max<std::size_t>(nThreads, 1U); ++i)
+		{
+			workers_.emplace_back([this]() { work(); });
+		}
+	}
+
+	Executor::~Executor()
+	{
+		{
+			std::scoped_lock lock{ mutex_ };
+			stopping_ = true;
+		}
+		tasksAvailable_.notify_all();
+
+		workers_.clear();
+	}
+
+	void Executor::post(Task task) noexcept
+	{
+		{
+			std::scoped_lock lock{ mutex_ };
+			tasks_.push_back(std::move(task));
+		}
+		tasksAvailable_.notify_one();
+	}
+
+	void Executor::runShared(const std::function<void()>& work, const std::size_t helpers) noexcept
+	{
+		// the helpers' tasks may outlive the call, so only those which joined before it closed touch work
+		struct Helpers
+		{
+			std::mutex mutex;
+			std::condition_variable finished;
+			std::size_t running{ 0U };
+			bool closed{ false };
+		};
+		const auto shared = std::make_shared<Helpers>();
+
+		for (std::size_t i{ 0U }; i < helpers; ++i)
+		{
+			post([shared, &work]()
+			{
+				{
+					std::scoped_lock lock{ shared->mutex };
+					if (shared->closed)
+					{
+						return;
+					}
+					++shared->running;
+				}
+
+				work();
+
+				{
+					std::scoped_lock lock{ shared->mutex };
+					--shared->running;
+				}
+				shared->finished.notify_all();
+			});
+		}
+
+		work();
+
+		std::unique_lock lock{ shared->mutex };
+		shared->closed = true;
+		shared->finished.wait(lock, [&shared]() { return shared->running == 0U; });
+	}
+
+	void Executor::work() noexcept
+	{
+		while (true)
+		{
+			Task task{};
+			{
+				std::unique_lock lock{ mutex_ };
+				tasksAvailable_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+				if (tasks_.empty())
+				{
+					return;
+				}
+
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+
+			task();
+		}
+	}
+}
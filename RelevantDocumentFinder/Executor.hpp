@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// a fixed pool of worker threads running posted tasks in FIFO order
+	// destruction waits for every task already posted
+	class Executor
+	{
+	public:
+		using Task = std::function<void()>;
+
+		explicit Executor(const std::size_t nThreads);
+
+		~Executor();
+
+		Executor(const Executor&) = delete;
+		Executor& operator=(const Executor&) = delete;
+
+		void post(Task task) noexcept;
+
+		// runs work on the calling thread and on up to helpers threads of the pool, returning once every run returned
+		// work shares its items out itself; a helper starting after the caller's run returned skips it,
+		// so the caller never waits on tasks queued behind others, nor deadlocks when called from a task
+		void runShared(const std::function<void()>& work, const std::size_t helpers) noexcept;
+
+		[[nodiscard]] std::size_t threadCount() const noexcept { return std::size(workers_); }
+
+	private:
+		std::deque<Task> tasks_;
+		bool stopping_{ false };
+		std::mutex mutex_;
+		std::condition_variable tasksAvailable_;
+		std::vector<std::jthread> workers_;
+
+		void work() noexcept;
+	};
+}
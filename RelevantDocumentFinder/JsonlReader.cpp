@@ -0,0 +1,373 @@
+#include "JsonlReader.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+namespace RelDocFinder
+{
+	namespace
+	{
+		[[nodiscard]] bool isSpace(const char c) noexcept
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		}
+
+		[[nodiscard]] char* skipSpaces(char* p, const char* const last) noexcept
+		{
+			while (p != last && isSpace(*p))
+			{
+				++p;
+			}
+			return p;
+		}
+
+		// the first '"' or '\\' of [p, last), which are all a string scan ever stops at
+		[[nodiscard]] char* findQuoteOrBackslash(char* p, char* const last) noexcept
+		{
+#if defined(__AVX2__)
+			const __m256i quotes{ _mm256_set1_epi8('"') };
+			const __m256i backslashes{ _mm256_set1_epi8('\\') };
+			for (; last - p >= 32; p += 32)
+			{
+				const __m256i chars{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) };
+				const std::uint32_t mask{ static_cast<std::uint32_t>(_mm256_movemask_epi8(
+					_mm256_or_si256(_mm256_cmpeq_epi8(chars, quotes), _mm256_cmpeq_epi8(chars, backslashes)))) };
+				if (mask != 0U)
+				{
+					return p + std::countr_zero(mask);
+				}
+			}
+#endif
+			while (p != last && *p != '"' && *p != '\\')
+			{
+				++p;
+			}
+			return p;
+		}
+
+		[[nodiscard]] int hexDigit(const char c) noexcept
+		{
+			if (c >= '0' && c <= '9')
+			{
+				return c - '0';
+			}
+			if (c >= 'a' && c <= 'f')
+			{
+				return c - 'a' + 10;
+			}
+			if (c >= 'A' && c <= 'F')
+			{
+				return c - 'A' + 10;
+			}
+			return -1;
+		}
+
+		// the code unit of \uXXXX at p, which points past the u, or -1 if it is not four hex digits
+		[[nodiscard]] long codeUnit(const char* p, const char* const last) noexcept
+		{
+			if (last - p < 4)
+			{
+				return -1;
+			}
+
+			long unit{ 0 };
+			for (int i{ 0 }; i < 4; ++i)
+			{
+				const int digit{ hexDigit(p[i]) };
+				if (digit < 0)
+				{
+					return -1;
+				}
+				unit = unit * 16 + digit;
+			}
+			return unit;
+		}
+
+		[[nodiscard]] char* putUtf8(char* out, const std::uint32_t codePoint) noexcept
+		{
+			if (codePoint < 0x80U)
+			{
+				*out++ = static_cast<char>(codePoint);
+			}
+			else if (codePoint < 0x800U)
+			{
+				*out++ = static_cast<char>(0xC0U | (codePoint >> 6U));
+				*out++ = static_cast<char>(0x80U | (codePoint & 0x3FU));
+			}
+			else if (codePoint < 0x10000U)
+			{
+				*out++ = static_cast<char>(0xE0U | (codePoint >> 12U));
+				*out++ = static_cast<char>(0x80U | ((codePoint >> 6U) & 0x3FU));
+				*out++ = static_cast<char>(0x80U | (codePoint & 0x3FU));
+			}
+			else
+			{
+				*out++ = static_cast<char>(0xF0U | (codePoint >> 18U));
+				*out++ = static_cast<char>(0x80U | ((codePoint >> 12U) & 0x3FU));
+				*out++ = static_cast<char>(0x80U | ((codePoint >> 6U) & 0x3FU));
+				*out++ = static_cast<char>(0x80U | (codePoint & 0x3FU));
+			}
+			return out;
+		}
+
+		// p points past the opening quote, returns past the closing one, or last for an unterminated string
+		// with unescape the string is unescaped in place and its end returned in valueEnd
+		[[nodiscard]] char* scanString(char* p, char* const last, const bool unescape, char*& valueEnd) noexcept
+		{
+			char* out{ p };
+			while (true)
+			{
+				char* const special{ findQuoteOrBackslash(p, last) };
+				if (unescape && out != p)
+				{
+					std::memmove(out, p, static_cast<std::size_t>(special - p));
+				}
+				out += special - p;
+				p = special;
+
+				if (p == last || *p == '"')
+				{
+					valueEnd = out;
+					return p == last ? p : p + 1;
+				}
+
+				// an escape, a \u of a surrogate pair takes the next \u with it
+				if (++p == last)
+				{
+					valueEnd = out;
+					return p;
+				}
+
+				if (!unescape)
+				{
+					++p;
+					continue;
+				}
+
+				switch (const char c{ *p++ })
+				{
+				case 'b': *out++ = '\b'; break;
+				case 'f': *out++ = '\f'; break;
+				case 'n': *out++ = '\n'; break;
+				case 'r': *out++ = '\r'; break;
+				case 't': *out++ = '\t'; break;
+				case 'u':
+				{
+					long unit{ codeUnit(p, last) };
+					if (unit < 0)
+					{
+						*out++ = 'u';
+						break;
+					}
+					p += 4;
+
+					std::uint32_t codePoint{ static_cast<std::uint32_t>(unit) };
+					if (unit >= 0xD800 && unit <= 0xDBFF && last - p >= 6 && p[0] == '\\' && p[1] == 'u')
+					{
+						if (const long low{ codeUnit(p + 2, last) }; low >= 0xDC00 && low <= 0xDFFF)
+						{
+							codePoint = 0x10000U + ((codePoint - 0xD800U) << 10U) + static_cast<std::uint32_t>(low - 0xDC00);
+							p += 6;
+						}
+					}
+					out = putUtf8(out, codePoint);
+					break;
+				}
+				default:
+					// \" \\ \/ and any unknown escape stand for the character itself
+					*out++ = c;
+					break;
+				}
+			}
+		}
+
+		// skips a number, literal, object or array, returns where it ends
+		[[nodiscard]] char* skipValue(char* p, char* const last) noexcept
+		{
+			std::size_t depth{ 0U };
+			char* ignored{ nullptr };
+			while (p != last)
+			{
+				const char c{ *p };
+				if (c == '"')
+				{
+					p = scanString(p + 1, last, false, ignored);
+					continue;
+				}
+
+				if (c == '{' || c == '[')
+				{
+					++depth;
+				}
+				else if (c == '}' || c == ']')
+				{
+					if (depth == 0U)
+					{
+						return p;
+					}
+					--depth;
+				}
+				else if (c == ',' && depth == 0U)
+				{
+					return p;
+				}
+				++p;
+			}
+			return p;
+		}
+	}
+
+	JsonlReader::JsonlReader(std::istream& input, const JsonlKeys& keys, const std::size_t bufferBytes, const std::size_t maxRecordBytes)
+		: input_{ input }, keys_{ keys.idKey }, buffer_(std::max<std::size_t>(bufferBytes, 16U)), maxRecordBytes_{ std::max<std::size_t>(maxRecordBytes, 1U) }
+	{
+		for (const JsonlTextKey& textKey : keys.textKeys)
+		{
+			keys_.push_back(textKey.key);
+		}
+		values_.resize(std::size(keys_));
+	}
+
+	bool JsonlReader::readRecord()
+	{
+		while (true)
+		{
+			const char* const data{ buffer_.data() };
+			const void* const lf{ std::memchr(data + scanned_, '\n', end_ - scanned_) };
+			scanned_ = lf ? static_cast<std::size_t>(static_cast<const char*>(lf) - data) : end_;
+
+			if (!lf && !exhausted_)
+			{
+				// the scanned part of an oversized line is dropped, only its LF is still looked for
+				if (end_ - begin_ >= maxRecordBytes_) [[unlikely]]
+				{
+					begin_ = end_;
+					oversized_ = true;
+				}
+
+				refill();
+				continue;
+			}
+
+			const bool oversized{ std::exchange(oversized_, false) };
+			if (begin_ == end_ && !oversized) [[unlikely]]
+			{
+				return false;
+			}
+
+			char* const first{ buffer_.data() + begin_ };
+			char* const last{ buffer_.data() + scanned_ };
+			begin_ = lf ? scanned_ + 1U : end_;
+			scanned_ = begin_;
+
+			if (oversized) [[unlikely]]
+			{
+				++skippedRecords_;
+				continue;
+			}
+
+			if (skipSpaces(first, last) == last)
+			{
+				continue;
+			}
+
+			parseObject(first, last);
+			return true;
+		}
+	}
+
+	void JsonlReader::refill()
+	{
+		if (begin_ != 0U)
+		{
+			std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+			end_ -= begin_;
+			scanned_ -= begin_;
+			begin_ = 0U;
+		}
+
+		if (end_ == std::size(buffer_))
+		{
+			buffer_.resize(2U * std::size(buffer_));
+		}
+
+		input_.read(buffer_.data() + end_, static_cast<std::streamsize>(std::size(buffer_) - end_));
+		const std::size_t read{ static_cast<std::size_t>(input_.gcount()) };
+		end_ += read;
+		exhausted_ = read == 0U;
+	}
+
+	void JsonlReader::parseObject(char* first, char* const last) noexcept
+	{
+		std::ranges::fill(values_, std::string_view{});
+
+		char* p{ skipSpaces(first, last) };
+		if (p == last || *p != '{')
+		{
+			return;
+		}
+		++p;
+
+		while (true)
+		{
+			p = skipSpaces(p, last);
+			if (p == last || *p != '"')
+			{
+				return;
+			}
+
+			// keys are unescaped too, they are rarely escaped and then still have to match
+			char* const keyBegin{ p + 1 };
+			char* keyEnd{ nullptr };
+			p = skipSpaces(scanString(keyBegin, last, true, keyEnd), last);
+			if (p == last || *p != ':')
+			{
+				return;
+			}
+			p = skipSpaces(p + 1, last);
+
+			const std::string_view key{ keyBegin, static_cast<std::size_t>(keyEnd - keyBegin) };
+			const auto wanted = std::ranges::find(keys_, key);
+			std::string_view* const value{ wanted != keys_.end() ? &values_[static_cast<std::size_t>(wanted - keys_.begin())] : nullptr };
+
+			if (p != last && *p == '"')
+			{
+				char* valueEnd{ nullptr };
+				char* const valueBegin{ p + 1 };
+				p = scanString(valueBegin, last, value != nullptr, valueEnd);
+				if (value)
+				{
+					*value = std::string_view{ valueBegin, static_cast<std::size_t>(valueEnd - valueBegin) };
+				}
+			}
+			else
+			{
+				char* const valueBegin{ p };
+				p = skipValue(p, last);
+				if (value == &values_.front() && valueBegin != p && (*valueBegin == '-' || (*valueBegin >= '0' && *valueBegin <= '9')))
+				{
+					char* valueEnd{ p };
+					while (valueEnd != valueBegin && isSpace(valueEnd[-1]))
+					{
+						--valueEnd;
+					}
+					*value = std::string_view{ valueBegin, static_cast<std::size_t>(valueEnd - valueBegin) };
+				}
+			}
+
+			p = skipSpaces(p, last);
+			if (p == last || *p != ',')
+			{
+				return;
+			}
+			++p;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// a text key of a json object, named to make it a field of the document
+	struct JsonlTextKey
+	{
+		std::string key;
+		std::string field;
+	};
+
+	// how the keys of a json object map to a document
+	struct JsonlKeys
+	{
+		std::string idKey{ "id" };
+
+		// every key is a field if every one is named, else their values are joined by spaces into a plain document
+		std::vector<JsonlTextKey> textKeys{ { "text", "" } };
+	};
+
+
+	// streams JSON Lines, one object per line, extracting the values of the id and text keys only
+	// strings are unescaped in place and the id may also be a number, returned as written
+	// any other value, null included, is skipped unparsed and empty like a missing key
+	// a line which is not an object yields empty values, like an object without the keys
+	class JsonlReader
+	{
+	public:
+		// a line of more than maxRecordBytes is skipped, so the buffer never grows past about twice that
+		JsonlReader(std::istream& input, const JsonlKeys& keys, const std::size_t bufferBytes = 64U * 1024U,
+			const std::size_t maxRecordBytes = 64U * 1024U * 1024U);
+
+		// false once the input is exhausted, blank lines are skipped
+		[[nodiscard]] bool readRecord();
+
+		// the values of the id key and then of the text keys of the last record read, empty for a missing key
+		// views into the reader's buffer until the next readRecord
+		[[nodiscard]] std::span<const std::string_view> fields() const noexcept { return values_; }
+
+		// #(lines skipped for exceeding maxRecordBytes)
+		[[nodiscard]] std::size_t skippedRecords() const noexcept { return skippedRecords_; }
+
+	private:
+		std::istream& input_;
+		std::vector<std::string> keys_;			// the id key first
+		std::vector<char> buffer_;
+		std::size_t begin_{ 0U };				// the unread lines start here
+		std::size_t end_{ 0U };					// the buffered input ends here
+		std::size_t scanned_{ 0U };				// the line at begin_ has no LF before here
+		bool exhausted_{ false };
+		std::size_t maxRecordBytes_;
+		bool oversized_{ false };				// the line at begin_ is being skipped, its start is already dropped
+
+		std::vector<std::string_view> values_;
+		std::size_t skippedRecords_{ 0U };
+
+
+		// moves the unread input to the front of the buffer, growing it if the line fills it, and reads more
+		void refill();
+
+		// fills values_ from the object on [first, last)
+		void parseObject(char* first, char* const last) noexcept;
+	};
+}
@@ -0,0 +1,160 @@
+#include "Lz77.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace RelDocFinder::Lz77
+{
+	namespace
+	{
+		constexpr std::size_t minMatch{ 4U };
+		constexpr std::size_t maxOffset{ 65535U };
+		constexpr std::size_t lastLiterals{ 5U };			// the input always ends in literals, so matches never run off it
+		constexpr unsigned hashBits{ 12U };
+
+		[[nodiscard]] std::uint32_t load32(const char* p) noexcept
+		{
+			std::uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		[[nodiscard]] std::uint32_t hash(const std::uint32_t sequence) noexcept
+		{
+			return (sequence * 2654435761U) >> (32U - hashBits);
+		}
+
+		void putLength(std::vector<std::uint8_t>& out, std::size_t length) noexcept
+		{
+			for (; length >= 255U; length -= 255U)
+			{
+				out.push_back(255U);
+			}
+			out.push_back(static_cast<std::uint8_t>(length));
+		}
+
+		[[nodiscard]] std::size_t getLength(const std::uint8_t*& in, const std::uint8_t* const end, std::size_t length) noexcept
+		{
+			if (length != 15U)
+			{
+				return length;
+			}
+
+			for (std::uint8_t byte{ 255U }; byte == 255U && in != end; )
+			{
+				byte = *in++;
+				length += byte;
+			}
+			return length;
+		}
+
+		void putSequence(std::vector<std::uint8_t>& out, std::string_view literals, const std::size_t offset, const std::size_t matchLength) noexcept
+		{
+			const std::size_t literalLength{ std::size(literals) };
+			const std::size_t matchCode{ matchLength != 0U ? matchLength - minMatch : 0U };
+			out.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literalLength, 15U) << 4U) | std::min<std::size_t>(matchCode, 15U)));
+
+			if (literalLength >= 15U)
+			{
+				putLength(out, literalLength - 15U);
+			}
+			out.insert(out.end(), literals.begin(), literals.end());
+
+			if (matchLength == 0U)
+			{
+				return;
+			}
+
+			out.push_back(static_cast<std::uint8_t>(offset & 0xFFU));
+			out.push_back(static_cast<std::uint8_t>(offset >> 8U));
+			if (matchCode >= 15U)
+			{
+				putLength(out, matchCode - 15U);
+			}
+		}
+	}
+
+	std::vector<std::uint8_t> compress(std::string_view input)
+	{
+		std::vector<std::uint8_t> out{};
+		out.reserve(std::size(input) / 2U + 16U);
+
+		// positions + 1 of the last 4 bytes hashing to each slot, 0 for none
+		std::vector<std::uint32_t> table(std::size_t{ 1U } << hashBits, 0U);
+
+		const char* const data{ input.data() };
+		std::size_t anchor{ 0U };
+		if (std::size(input) > minMatch + lastLiterals)
+		{
+			const std::size_t matchLimit{ std::size(input) - lastLiterals };
+			for (std::size_t i{ 0U }; i + minMatch <= matchLimit; )
+			{
+				const std::uint32_t sequence{ load32(data + i) };
+				std::uint32_t& slot{ table[hash(sequence)] };
+				const std::size_t candidate{ slot };
+				slot = static_cast<std::uint32_t>(i + 1U);
+
+				if (candidate == 0U || i - (candidate - 1U) > maxOffset || load32(data + candidate - 1U) != sequence)
+				{
+					++i;
+					continue;
+				}
+
+				const std::size_t match{ candidate - 1U };
+				std::size_t length{ minMatch };
+				while (i + length < matchLimit && data[match + length] == data[i + length])
+				{
+					++length;
+				}
+
+				putSequence(out, input.substr(anchor, i - anchor), i - match, length);
+				i += length;
+				anchor = i;
+			}
+		}
+
+		putSequence(out, input.substr(anchor), 0U, 0U);
+		return out;
+	}
+
+	std::string decompress(std::span<const std::uint8_t> compressed, const std::size_t rawSize)
+	{
+		std::string out(rawSize, '\0');
+		std::size_t written{ 0U };
+
+		const std::uint8_t* in{ compressed.data() };
+		const std::uint8_t* const end{ in + std::size(compressed) };
+		while (in != end)
+		{
+			const std::uint8_t token{ *in++ };
+
+			const std::size_t literalLength{ std::min(getLength(in, end, token >> 4U), std::min<std::size_t>(static_cast<std::size_t>(end - in), rawSize - written)) };
+			std::memcpy(out.data() + written, in, literalLength);
+			written += literalLength;
+			in += literalLength;
+
+			if (end - in < 2)
+			{
+				break;
+			}
+
+			const std::size_t offset{ static_cast<std::size_t>(in[0]) | static_cast<std::size_t>(in[1]) << 8U };
+			in += 2;
+			const std::size_t matchLength{ std::min(getLength(in, end, token & 0x0FU) + minMatch, rawSize - written) };
+			if (offset == 0U || offset > written) [[unlikely]]
+			{
+				break;
+			}
+
+			// the match may overlap what it copies, so it is copied byte by byte
+			for (std::size_t i{ 0U }; i < matchLength; ++i, ++written)
+			{
+				out[written] = out[written - offset];
+			}
+		}
+
+		out.resize(written);
+		return out;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// a small byte-oriented LZ77 codec in the style of the LZ4 block format, fast to decode and with no dictionary to ship
+// every sequence is a token (literal length << 4 | match length - 4), the literals, and a 2 byte little-endian offset,
+// lengths of 15 or more continue in bytes of 255, and the last sequence has literals only
+namespace RelDocFinder::Lz77
+{
+	[[nodiscard]] std::vector<std::uint8_t> compress(std::string_view input);
+
+	// rawSize must be the size of the input compressed
+	[[nodiscard]] std::string decompress(std::span<const std::uint8_t> compressed, const std::size_t rawSize);
+}
@@ -0,0 +1,73 @@
+#include "PostingCache.hpp"
+
+
+namespace RelDocFinder
+{
+	PostingCache::PostingCache(const std::size_t capacityBytes) : capacityBytes_{ capacityBytes }
+	{
+	}
+
+	PostingCache::DecodedPtr PostingCache::find(std::string_view word) noexcept
+	{
+		std::scoped_lock lock{ mutex_ };
+
+		const auto it = index_.find(word);
+		if (it == index_.end())
+		{
+			misses_.fetch_add(1U, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		hits_.fetch_add(1U, std::memory_order_relaxed);
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return it->second->decoded;
+	}
+
+	void PostingCache::insert(std::string_view word, DecodedPtr decoded) noexcept
+	{
+		const std::size_t bytes{ sizeof(Entry) + std::size(word)
+			+ std::size(decoded->ordinals) * (sizeof(DocOrdinal) + sizeof(Frequency)) };
+		if (bytes > capacityBytes_) [[unlikely]]
+		{
+			return;
+		}
+
+		std::scoped_lock lock{ mutex_ };
+
+		if (index_.contains(word))
+		{
+			return;
+		}
+
+		while (bytes_ + bytes > capacityBytes_)
+		{
+			bytes_ -= entries_.back().bytes;
+			index_.erase(entries_.back().word);
+			entries_.pop_back();
+		}
+
+		entries_.push_front(Entry{ std::string{ word }, std::move(decoded), bytes });
+		index_.emplace(entries_.front().word, entries_.begin());
+		bytes_ += bytes;
+	}
+
+	void PostingCache::erase(std::string_view word) noexcept
+	{
+		std::scoped_lock lock{ mutex_ };
+
+		if (const auto it = index_.find(word); it != index_.end())
+		{
+			bytes_ -= it->second->bytes;
+			const Entries::iterator entry{ it->second };
+			index_.erase(it);
+			entries_.erase(entry);
+		}
+	}
+
+	PostingCacheStats PostingCache::stats() const noexcept
+	{
+		std::scoped_lock lock{ mutex_ };
+
+		return { hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed), bytes_ };
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+#include "PostingList.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace RelDocFinder
+{
+	struct PostingCacheStats
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::size_t bytes;			// decoded bytes currently cached
+	};
+
+
+	// LRU cache of decoded posting lists, bounded by their decoded size in bytes
+	// the owner must erase a word whenever its posting list changes
+	class PostingCache
+	{
+	public:
+		using DecodedPtr = std::shared_ptr<const PostingList::Decoded>;
+
+		explicit PostingCache(const std::size_t capacityBytes);
+
+		[[nodiscard]] DecodedPtr find(std::string_view word) noexcept;
+
+		void insert(std::string_view word, DecodedPtr decoded) noexcept;
+
+		void erase(std::string_view word) noexcept;
+
+		[[nodiscard]] PostingCacheStats stats() const noexcept;
+
+	private:
+		struct Entry
+		{
+			std::string word;
+			DecodedPtr decoded;
+			std::size_t bytes;
+		};
+
+		// most recently used first
+		using Entries = std::list<Entry>;
+
+		std::size_t capacityBytes_;
+		std::size_t bytes_{ 0U };
+		Entries entries_;
+		std::unordered_map<std::string_view, Entries::iterator> index_;		// views into entries_
+		mutable std::mutex mutex_;
+
+		std::atomic<std::uint64_t> hits_{ 0U };
+		std::atomic<std::uint64_t> misses_{ 0U };
+	};
+}
@@ -0,0 +1,164 @@
+#include "PostingIntersection.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+namespace RelDocFinder::PostingIntersection
+{
+	namespace
+	{
+		// merges lhs[i..] with rhs[j..] to the end
+		void mergeFrom(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::size_t i, std::size_t j, std::vector<Match>& matches) noexcept
+		{
+			while (i < std::size(lhs) && j < std::size(rhs))
+			{
+				if (lhs[i] < rhs[j])
+				{
+					++i;
+				}
+				else if (rhs[j] < lhs[i])
+				{
+					++j;
+				}
+				else
+				{
+					matches.emplace_back(static_cast<std::uint32_t>(i++), static_cast<std::uint32_t>(j++));
+				}
+			}
+		}
+
+		// small is searched for in large, the matches keep lhs / rhs order
+		void gallopSmallInLarge(std::span<const DocOrdinal> small, std::span<const DocOrdinal> large, const bool smallIsLhs, std::vector<Match>& matches) noexcept
+		{
+			std::size_t low{ 0U };
+			for (std::size_t i{ 0U }; i < std::size(small) && low < std::size(large); ++i)
+			{
+				const DocOrdinal target{ small[i] };
+
+				// doubles the step until it passes the target, then binary searches the last step
+				std::size_t step{ 1U };
+				std::size_t high{ low };
+				while (high < std::size(large) && large[high] < target)
+				{
+					low = high + 1U;
+					high += step;
+					step *= 2U;
+				}
+
+				const auto end{ large.begin() + static_cast<std::ptrdiff_t>(std::min(high + 1U, std::size(large))) };
+				const auto pos{ std::lower_bound(large.begin() + static_cast<std::ptrdiff_t>(low), end, target) };
+				low = static_cast<std::size_t>(pos - large.begin());
+				if (pos != large.end() && *pos == target)
+				{
+					const auto j{ static_cast<std::uint32_t>(low++) };
+					matches.push_back(smallIsLhs ? Match{ static_cast<std::uint32_t>(i), j } : Match{ j, static_cast<std::uint32_t>(i) });
+				}
+			}
+		}
+	}
+
+	void merge(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept
+	{
+		mergeFrom(lhs, rhs, 0U, 0U, matches);
+	}
+
+	void gallop(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept
+	{
+		if (std::size(lhs) <= std::size(rhs))
+		{
+			gallopSmallInLarge(lhs, rhs, true, matches);
+		}
+		else
+		{
+			gallopSmallInLarge(rhs, lhs, false, matches);
+		}
+	}
+
+	void blockCompare(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept
+	{
+		std::size_t i{ 0U };
+		std::size_t j{ 0U };
+
+#if defined(__AVX2__)
+		// every 8 x 8 block is compared all against all, by comparing lhs with the 8 rotations of rhs
+		// both sides are unique and ascending, so the k-th match of lhs pairs with the k-th match of rhs
+		const __m256i rotate{ _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0) };
+		while (i + 8U <= std::size(lhs) && j + 8U <= std::size(rhs))
+		{
+			const __m256i vLhs{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs.data() + i)) };
+			__m256i vRhs{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs.data() + j)) };
+
+			__m256i lhsHits{ _mm256_cmpeq_epi32(vLhs, vRhs) };
+			for (int r{ 1 }; r < 8; ++r)
+			{
+				vRhs = _mm256_permutevar8x32_epi32(vRhs, rotate);
+				lhsHits = _mm256_or_si256(lhsHits, _mm256_cmpeq_epi32(vLhs, vRhs));
+			}
+
+			unsigned lhsMask{ static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(lhsHits))) };
+			if (lhsMask != 0U)
+			{
+				// the same compare from the other side finds the rhs positions
+				const __m256i vRhsBlock{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs.data() + j)) };
+				__m256i vLhsRotated{ vLhs };
+				__m256i rhsHits{ _mm256_cmpeq_epi32(vRhsBlock, vLhsRotated) };
+				for (int r{ 1 }; r < 8; ++r)
+				{
+					vLhsRotated = _mm256_permutevar8x32_epi32(vLhsRotated, rotate);
+					rhsHits = _mm256_or_si256(rhsHits, _mm256_cmpeq_epi32(vRhsBlock, vLhsRotated));
+				}
+
+				unsigned rhsMask{ static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(rhsHits))) };
+				for (; lhsMask != 0U; lhsMask &= lhsMask - 1U, rhsMask &= rhsMask - 1U)
+				{
+					matches.emplace_back(static_cast<std::uint32_t>(i + static_cast<std::size_t>(std::countr_zero(lhsMask))),
+						static_cast<std::uint32_t>(j + static_cast<std::size_t>(std::countr_zero(rhsMask))));
+				}
+			}
+
+			const DocOrdinal lhsLast{ lhs[i + 7U] };
+			const DocOrdinal rhsLast{ rhs[j + 7U] };
+			i += lhsLast <= rhsLast ? 8U : 0U;
+			j += rhsLast <= lhsLast ? 8U : 0U;
+		}
+#endif
+
+		mergeFrom(lhs, rhs, i, j, matches);
+	}
+
+	void intersect(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept
+	{
+		const std::size_t smaller{ std::min(std::size(lhs), std::size(rhs)) };
+		const std::size_t larger{ std::max(std::size(lhs), std::size(rhs)) };
+		if (smaller == 0U)
+		{
+			return;
+		}
+
+		if (smaller * gallopingRatio <= larger)
+		{
+			gallop(lhs, rhs, matches);
+		}
+		else
+		{
+			blockCompare(lhs, rhs, matches);
+		}
+	}
+
+	void intersect(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<DocOrdinal>& ordinals) noexcept
+	{
+		std::vector<Match> matches{};
+		intersect(lhs, rhs, matches);
+
+		ordinals.reserve(std::size(ordinals) + std::size(matches));
+		for (const Match match : matches)
+		{
+			ordinals.push_back(lhs[match.lhs]);
+		}
+	}
+}
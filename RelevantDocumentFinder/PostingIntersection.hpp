@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace RelDocFinder::PostingIntersection
+{
+	// positions of an ordinal which both sides hold
+	struct Match
+	{
+		std::uint32_t lhs;
+		std::uint32_t rhs;
+	};
+
+	// the smaller side gallops through the larger once the larger is this many times its size
+	inline constexpr std::size_t gallopingRatio{ 32U };
+
+	// both sides ascending without duplicates, the matches are appended ascending
+	// picks galloping for skewed sizes, else a block compare (AVX2) or a merge
+	void intersect(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept;
+
+	// the ordinals which both sides hold, appended ascending
+	void intersect(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<DocOrdinal>& ordinals) noexcept;
+
+	// the individual algorithms, for benchmarks and tests
+	void merge(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept;
+
+	void gallop(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept;
+
+	void blockCompare(std::span<const DocOrdinal> lhs, std::span<const DocOrdinal> rhs, std::vector<Match>& matches) noexcept;
+}
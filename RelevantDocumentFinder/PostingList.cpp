@@ -0,0 +1,260 @@
+#include "PostingList.hpp"
+#include "Varint.hpp"
+
+#include <algorithm>
+
+
+namespace RelDocFinder
+{
+	namespace
+	{
+		void insertSorted(PostingList::Decoded& decoded, const DocOrdinal ordinal, const Frequency frequency) noexcept
+		{
+			const auto pos{ std::ranges::lower_bound(decoded.ordinals, ordinal) };
+			decoded.frequencies.insert(decoded.frequencies.begin() + (pos - decoded.ordinals.begin()), frequency);
+			decoded.ordinals.insert(pos, ordinal);
+		}
+
+		[[nodiscard]] bool isLive(std::span<const std::uint64_t> liveOrdinals, const DocOrdinal ordinal) noexcept
+		{
+			return (liveOrdinals[ordinal >> 6U] >> (ordinal & 63U)) & 1U;
+		}
+
+		std::size_t retainSorted(PostingList::Decoded& decoded, std::span<const std::uint64_t> liveOrdinals) noexcept
+		{
+			std::size_t kept{ 0U };
+			for (std::size_t i{ 0U }; i < std::size(decoded.ordinals); ++i)
+			{
+				if (isLive(liveOrdinals, decoded.ordinals[i]))
+				{
+					decoded.ordinals[kept] = decoded.ordinals[i];
+					decoded.frequencies[kept] = decoded.frequencies[i];
+					++kept;
+				}
+			}
+
+			const std::size_t erased{ std::size(decoded.ordinals) - kept };
+			decoded.ordinals.resize(kept);
+			decoded.frequencies.resize(kept);
+			return erased;
+		}
+
+		bool eraseSorted(PostingList::Decoded& decoded, const DocOrdinal ordinal) noexcept
+		{
+			const auto pos{ std::ranges::lower_bound(decoded.ordinals, ordinal) };
+			if (pos == decoded.ordinals.end() || *pos != ordinal)
+			{
+				return false;
+			}
+
+			decoded.frequencies.erase(decoded.frequencies.begin() + (pos - decoded.ordinals.begin()));
+			decoded.ordinals.erase(pos);
+			return true;
+		}
+	}
+
+	PostingList::PostingList(const bool compressed) noexcept : compressed_{ compressed }
+	{
+	}
+
+	PostingList::Decoded PostingList::decode() const noexcept
+	{
+		if (isRoaring_)
+		{
+			Decoded decoded{ {}, decoded_.frequencies };
+			roaring_.appendTo(decoded.ordinals);
+			return decoded;
+		}
+
+		if (!compressed_)
+		{
+			return decoded_;
+		}
+
+		Decoded decoded{};
+		decoded.ordinals.reserve(size_);
+		decoded.frequencies.reserve(size_);
+
+		const std::uint8_t* in{ encoded_.data() };
+		DocOrdinal ordinal{ 0U };
+		for (std::size_t i{ 0U }; i < size_; ++i)
+		{
+			ordinal += Varint::get(in);
+			decoded.ordinals.push_back(ordinal);
+			decoded.frequencies.push_back(Varint::get(in));
+		}
+
+		return decoded;
+	}
+
+	void PostingList::insert(const DocOrdinal ordinal, const Frequency frequency) noexcept
+	{
+		if (isRoaring_)
+		{
+			if (roaring_.add(ordinal))
+			{
+				decoded_.frequencies.insert(decoded_.frequencies.begin() + roaring_.rank(ordinal), frequency);
+				size_ = roaring_.cardinality();
+				adaptRepresentation();
+			}
+			return;
+		}
+
+		if (!compressed_)
+		{
+			insertSorted(decoded_, ordinal, frequency);
+			size_ = std::size(decoded_.ordinals);
+			adaptRepresentation();
+			return;
+		}
+
+		// fresh ordinals are the largest so far and append, reused ones are inserted in place
+		if (size_ == 0U || ordinal > lastOrdinal_)
+		{
+			append(ordinal, frequency);
+			return;
+		}
+
+		Decoded decoded{ decode() };
+		insertSorted(decoded, ordinal, frequency);
+		encode(decoded);
+	}
+
+	bool PostingList::erase(const DocOrdinal ordinal) noexcept
+	{
+		if (isRoaring_)
+		{
+			const std::size_t rank{ roaring_.rank(ordinal) };
+			if (!roaring_.remove(ordinal))
+			{
+				return false;
+			}
+
+			decoded_.frequencies.erase(decoded_.frequencies.begin() + rank);
+			size_ = roaring_.cardinality();
+			adaptRepresentation();
+			return true;
+		}
+
+		if (!compressed_)
+		{
+			const bool found{ eraseSorted(decoded_, ordinal) };
+			size_ = std::size(decoded_.ordinals);
+			return found;
+		}
+
+		Decoded decoded{ decode() };
+		if (!eraseSorted(decoded, ordinal))
+		{
+			return false;
+		}
+
+		encode(decoded);
+		return true;
+	}
+
+	bool PostingList::setFrequency(const DocOrdinal ordinal, const Frequency frequency) noexcept
+	{
+		if (isRoaring_)
+		{
+			if (!roaring_.contains(ordinal))
+			{
+				return false;
+			}
+
+			decoded_.frequencies[roaring_.rank(ordinal)] = frequency;
+			return true;
+		}
+
+		Decoded decoded{};
+		Decoded& target{ compressed_ ? (decoded = decode()) : decoded_ };
+
+		const auto pos{ std::ranges::lower_bound(target.ordinals, ordinal) };
+		if (pos == target.ordinals.end() || *pos != ordinal)
+		{
+			return false;
+		}
+
+		target.frequencies[pos - target.ordinals.begin()] = frequency;
+
+		if (compressed_)
+		{
+			encode(target);
+		}
+
+		return true;
+	}
+
+	std::size_t PostingList::retainLive(std::span<const std::uint64_t> liveOrdinals) noexcept
+	{
+		if (isRoaring_)
+		{
+			Decoded decoded{ decode() };
+			const std::size_t erased{ retainSorted(decoded, liveOrdinals) };
+			if (erased != 0U)
+			{
+				roaring_ = RoaringBitmap::fromSorted(decoded.ordinals);
+				decoded_.frequencies = std::move(decoded.frequencies);
+				size_ = roaring_.cardinality();
+				adaptRepresentation();
+			}
+			return erased;
+		}
+
+		if (!compressed_)
+		{
+			const std::size_t erased{ retainSorted(decoded_, liveOrdinals) };
+			size_ = std::size(decoded_.ordinals);
+			adaptRepresentation();
+			return erased;
+		}
+
+		Decoded decoded{ decode() };
+		const std::size_t erased{ retainSorted(decoded, liveOrdinals) };
+		if (erased != 0U)
+		{
+			encode(decoded);
+		}
+		return erased;
+	}
+
+	void PostingList::adaptRepresentation() noexcept
+	{
+		if (!isRoaring_)
+		{
+			if (size_ >= roaringMinSize && size_ * roaringDensity > decoded_.ordinals.back())
+			{
+				roaring_ = RoaringBitmap::fromSorted(decoded_.ordinals);
+				decoded_.ordinals = {};
+				isRoaring_ = true;
+			}
+			return;
+		}
+
+		if (size_ < roaringMinSize / 2U || size_ * roaringDensity * 4U <= roaring_.maximum())
+		{
+			decoded_.ordinals.clear();
+			roaring_.appendTo(decoded_.ordinals);
+			roaring_ = {};
+			isRoaring_ = false;
+		}
+	}
+
+	void PostingList::encode(const Decoded& decoded) noexcept
+	{
+		encoded_.clear();
+		size_ = 0U;
+		for (std::size_t i{ 0U }; i < std::size(decoded.ordinals); ++i)
+		{
+			append(decoded.ordinals[i], decoded.frequencies[i]);
+		}
+	}
+
+	void PostingList::append(const DocOrdinal ordinal, const Frequency frequency) noexcept
+	{
+		Varint::put(encoded_, ordinal - (size_ == 0U ? 0U : lastOrdinal_));
+		Varint::put(encoded_, frequency);
+		lastOrdinal_ = ordinal;
+		++size_;
+	}
+}
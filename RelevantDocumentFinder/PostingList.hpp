@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+#include "RoaringBitmap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// the documents which a word appears in, ascending by ordinal, with the word's frequency in each
+	// a compressed list keeps (ordinal gap, frequency) pairs as varints and has to be decoded before scoring
+	// an uncompressed list of a very common word switches to a roaring bitmap of its ordinals, which is read chunk by chunk
+	class PostingList
+	{
+	public:
+		struct Decoded
+		{
+			std::vector<DocOrdinal> ordinals;
+			std::vector<Frequency> frequencies;		// frequencies[i] is the word's frequency in ordinals[i]
+		};
+
+		explicit PostingList(const bool compressed) noexcept;
+
+		[[nodiscard]] bool isCompressed() const noexcept { return compressed_; }
+
+		// whether ordinals() and frequencies() are valid, otherwise the list is roaring or has to be decoded
+		[[nodiscard]] bool isFlat() const noexcept { return !compressed_ && !isRoaring_; }
+
+		[[nodiscard]] bool isRoaring() const noexcept { return isRoaring_; }
+
+		[[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+		[[nodiscard]] bool empty() const noexcept { return size_ == 0U; }
+
+		// only valid for flat lists
+		[[nodiscard]] std::span<const DocOrdinal> ordinals() const noexcept { return decoded_.ordinals; }
+
+		// valid for flat and roaring lists, in the order of the ordinals
+		[[nodiscard]] std::span<const Frequency> frequencies() const noexcept { return decoded_.frequencies; }
+
+		// only valid for roaring lists
+		[[nodiscard]] const RoaringBitmap& roaring() const noexcept { return roaring_; }
+
+		[[nodiscard]] Decoded decode() const noexcept;
+
+		void insert(const DocOrdinal ordinal, const Frequency frequency) noexcept;
+
+		bool erase(const DocOrdinal ordinal) noexcept;
+
+		bool setFrequency(const DocOrdinal ordinal, const Frequency frequency) noexcept;
+
+		// erases the postings of the ordinals which are not set in the liveOrdinals bitmap, returns #(postings erased)
+		std::size_t retainLive(std::span<const std::uint64_t> liveOrdinals) noexcept;
+
+	private:
+		// an uncompressed list becomes a roaring bitmap once it holds this many postings and covers 1 / 16 of its ordinals,
+		// and goes back to flat arrays below half as many postings or 1 / 64 of its ordinals, so it never flips back and forth
+		static constexpr std::size_t roaringMinSize{ 4096U };
+		static constexpr std::size_t roaringDensity{ 16U };
+
+		bool compressed_;
+		bool isRoaring_{ false };
+		std::size_t size_{ 0U };
+		DocOrdinal lastOrdinal_{ 0U };
+		Decoded decoded_;								// flat lists, and the frequencies of roaring lists
+		std::vector<std::uint8_t> encoded_;				// compressed lists
+		RoaringBitmap roaring_;							// roaring lists
+
+		// switches an uncompressed list between flat arrays and a roaring bitmap
+		void adaptRepresentation() noexcept;
+
+		void encode(const Decoded& decoded) noexcept;
+
+		void append(const DocOrdinal ordinal, const Frequency frequency) noexcept;
+	};
+}
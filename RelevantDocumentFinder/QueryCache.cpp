@@ -0,0 +1,63 @@
+#include "QueryCache.hpp"
+
+
+namespace RelDocFinder
+{
+	QueryCache::QueryCache(const std::size_t capacity) : capacity_{ capacity }
+	{
+		index_.reserve(capacity);
+	}
+
+	std::optional<QueryCache::Result> QueryCache::find(std::string_view normalizedQuery, const std::size_t n, const std::uint64_t generation) noexcept
+	{
+		std::scoped_lock lock{ mutex_ };
+
+		const auto it = index_.find(Key{ std::string{ normalizedQuery }, n });
+		if (it == index_.end())
+		{
+			return { };
+		}
+
+		if (it->second->generation != generation) [[unlikely]]
+		{
+			entries_.erase(it->second);
+			index_.erase(it);
+			return { };
+		}
+
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return it->second->result;
+	}
+
+	void QueryCache::insert(std::string_view normalizedQuery, const std::size_t n, const std::uint64_t generation, Result result) noexcept
+	{
+		if (capacity_ == 0U) [[unlikely]]
+		{
+			return;
+		}
+
+		std::scoped_lock lock{ mutex_ };
+
+		Key key{ std::string{ normalizedQuery }, n };
+		if (const auto it = index_.find(key); it != index_.end())
+		{
+			// a concurrent miss may have raced us here, keep whichever result is newer
+			if (it->second->generation <= generation)
+			{
+				it->second->generation = generation;
+				it->second->result = std::move(result);
+			}
+			entries_.splice(entries_.begin(), entries_, it->second);
+			return;
+		}
+
+		if (std::size(entries_) == capacity_)
+		{
+			index_.erase(entries_.back().key);
+			entries_.pop_back();
+		}
+
+		entries_.push_front(Entry{ key, generation, std::move(result) });
+		index_.emplace(std::move(key), entries_.begin());
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "QueryResult.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace RelDocFinder
+{
+	// bounded LRU cache of query results, keyed by the normalized query and n
+	// every entry remembers the corpus generation it was computed at, entries of an older generation are misses
+	// it is guarded by its own mutex, so hits never touch the corpus lock
+	// cached results pin their documents until they are evicted
+	class QueryCache
+	{
+	public:
+		using Result = QueryResult;
+
+		explicit QueryCache(const std::size_t capacity);
+
+		[[nodiscard]] std::optional<Result> find(std::string_view normalizedQuery, const std::size_t n, const std::uint64_t generation) noexcept;
+
+		void insert(std::string_view normalizedQuery, const std::size_t n, const std::uint64_t generation, Result result) noexcept;
+
+	private:
+		struct Key
+		{
+			std::string normalizedQuery;
+			std::size_t n;
+
+			friend bool operator==(const Key&, const Key&) = default;
+		};
+
+		struct KeyHash
+		{
+			std::size_t operator()(const Key& key) const noexcept
+			{
+				return std::hash<std::string>()(key.normalizedQuery) ^ (std::hash<std::size_t>()(key.n) * 0x9E3779B97F4A7C15U);
+			}
+		};
+
+		struct Entry
+		{
+			Key key;
+			std::uint64_t generation;
+			Result result;
+		};
+
+		// most recently used first
+		using Entries = std::list<Entry>;
+
+		std::size_t capacity_;
+		Entries entries_;
+		std::unordered_map<Key, Entries::iterator, KeyHash> index_;
+		std::mutex mutex_;
+	};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Reranker.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <stop_token>
+
+
+namespace RelDocFinder
+{
+	enum class QueryStatus
+	{
+		complete,
+		cancelled,				// the query's stop token was triggered
+		deadlineExceeded		// the query's deadline passed
+	};
+
+
+	struct QueryOptions
+	{
+		std::optional<std::chrono::steady_clock::time_point> deadline{};
+		std::stop_token stopToken{};
+
+		// a second stage re-scoring the best rerankDepth tf-idf hits, see Reranker
+		// rerankDepth should be well above n, 0 or no reranker disables it
+		std::size_t rerankDepth{ 0U };
+		Reranker reranker{};
+	};
+
+
+	// queries which can never be stopped early skip the checks altogether
+	[[nodiscard]] inline bool isInterruptible(const QueryOptions& options) noexcept
+	{
+		return options.deadline.has_value() || options.stopToken.stop_possible();
+	}
+
+	[[nodiscard]] inline QueryStatus checkQueryOptions(const QueryOptions& options) noexcept
+	{
+		if (options.stopToken.stop_requested())
+		{
+			return QueryStatus::cancelled;
+		}
+
+		if (options.deadline.has_value() && std::chrono::steady_clock::now() >= *options.deadline)
+		{
+			return QueryStatus::deadlineExceeded;
+		}
+
+		return QueryStatus::complete;
+	}
+
+
+	// checks an interruptible query once per interval steps of work, rather than at every step
+	// once the query is stopped it stays stopped, status tells why
+	class QueryChecker
+	{
+	public:
+		QueryChecker(const QueryOptions& options, QueryStatus& status, const std::size_t interval) noexcept
+			: options_{ options }, status_{ status }, interval_{ interval }
+		{
+		}
+
+		// counts steps done, true once the query is stopped
+		[[nodiscard]] bool stopped(const std::size_t steps) noexcept
+		{
+			if (status_ != QueryStatus::complete)
+			{
+				return true;
+			}
+
+			pending_ += steps;
+			if (pending_ < interval_) [[likely]]
+			{
+				return false;
+			}
+
+			pending_ = 0U;
+			status_ = checkQueryOptions(options_);
+			return status_ != QueryStatus::complete;
+		}
+
+	private:
+		const QueryOptions& options_;
+		QueryStatus& status_;
+		std::size_t interval_;
+		std::size_t pending_{ 0U };
+	};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+#include "QueryOptions.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	struct DocInfo
+	{
+		DocId docId;
+		double tfIdfScore;
+	};
+
+
+	struct QueryHit
+	{
+		DocId docId;
+		double score;
+		std::string_view text;			// empty if the corpus does not store documents
+	};
+
+
+	// the ranked hits of a query, highest score first
+	// every hit's text stays valid for the lifetime of the result, even if the document is deleted or updated meanwhile
+	class QueryResult
+	{
+	public:
+		using const_iterator = std::vector<QueryHit>::const_iterator;
+
+		[[nodiscard]] QueryStatus status() const noexcept { return status_; }
+
+		// the query was stopped before all of its postings were scored, the hits are the best found until then
+		[[nodiscard]] bool isPartial() const noexcept { return status_ != QueryStatus::complete; }
+
+		[[nodiscard]] std::size_t size() const noexcept { return std::size(hits_); }
+
+		[[nodiscard]] bool empty() const noexcept { return hits_.empty(); }
+
+		[[nodiscard]] const QueryHit& operator[](const std::size_t idx) const noexcept { return hits_[idx]; }
+
+		[[nodiscard]] const_iterator begin() const noexcept { return hits_.begin(); }
+
+		[[nodiscard]] const_iterator end() const noexcept { return hits_.end(); }
+
+	private:
+		friend class Corpus;
+
+		QueryStatus status_{ QueryStatus::complete };
+		std::vector<QueryHit> hits_;
+		std::vector<PinnedText> pinnedDocuments_;		// the documents hits_ views into
+	};
+}
@@ -0,0 +1,19 @@
+#include "Reranker.hpp"
+
+
+namespace RelDocFinder
+{
+	Reranker proximityReranker(const double weight)
+	{
+		return [weight](std::span<RerankCandidate> candidates, const RerankContext& context)
+		{
+			for (RerankCandidate& candidate : candidates)
+			{
+				if (const std::optional<ProximityWindow> window = context.proximityWindow(candidate.docId))
+				{
+					candidate.score *= 1.0 + weight * static_cast<double>(window->words - 1U) / static_cast<double>(window->span - 1U);
+				}
+			}
+		};
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+
+
+namespace RelDocFinder
+{
+	// how close together the words of a query occur in a document
+	struct ProximityWindow
+	{
+		std::size_t words;				// #(query words in the document), at least 2
+		std::uint32_t span;				// the fewest consecutive positions holding all of them
+	};
+
+	// a first-stage hit handed to the second stage, with the features it may score by
+	struct RerankCandidate
+	{
+		DocId docId;
+		double score;					// the tf-idf score, for the re-ranker to overwrite
+		std::size_t length;				// #(words in the document)
+	};
+
+	// what a re-ranker may look up about the query, only valid during the call
+	struct RerankContext
+	{
+		std::span<const std::string_view> queryWords;
+
+		// none without positions, or if the document holds fewer than two of the query words
+		std::function<std::optional<ProximityWindow>(DocId docId)> proximityWindow;
+
+		// fetched, and decompressed, only when asked for, so a re-ranker which needs no text pays nothing for it
+		// empty if the corpus does not store documents, the text stays valid until the re-ranker returns
+		std::function<std::string_view(DocId docId)> documentText;
+	};
+
+	// re-scores a whole batch of candidates at once, the corpus then keeps the n best
+	// it runs while the corpus is locked for reading, so it must not write to the corpus
+	using Reranker = std::function<void(std::span<RerankCandidate> candidates, const RerankContext& context)>;
+
+
+	// score * (1 + weight * (#(words) - 1) / (span - 1)), so adjacent words multiply the score by 1 + weight
+	[[nodiscard]] Reranker proximityReranker(const double weight = 1.0);
+}
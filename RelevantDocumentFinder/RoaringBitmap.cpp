@@ -0,0 +1,325 @@
+#include "RoaringBitmap.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+
+namespace RelDocFinder
+{
+	namespace
+	{
+		[[nodiscard]] std::uint16_t highBits(const std::uint32_t value) noexcept
+		{
+			return static_cast<std::uint16_t>(value >> 16U);
+		}
+
+		[[nodiscard]] std::uint16_t lowBits(const std::uint32_t value) noexcept
+		{
+			return static_cast<std::uint16_t>(value & 0xFFFFU);
+		}
+
+		[[nodiscard]] bool testBit(std::span<const std::uint64_t> bitmap, const std::uint16_t low) noexcept
+		{
+			return (bitmap[low >> 6U] >> (low & 63U)) & 1U;
+		}
+
+		[[nodiscard]] std::uint32_t popcount(std::span<const std::uint64_t> bitmap) noexcept
+		{
+			std::uint32_t count{ 0U };
+			for (const std::uint64_t word : bitmap)
+			{
+				count += static_cast<std::uint32_t>(std::popcount(word));
+			}
+			return count;
+		}
+	}
+
+	RoaringBitmap RoaringBitmap::fromSorted(std::span<const std::uint32_t> values) noexcept
+	{
+		RoaringBitmap roaring{};
+		for (std::size_t begin{ 0U }; begin < std::size(values); )
+		{
+			const std::uint16_t key{ highBits(values[begin]) };
+			std::size_t end{ begin };
+			Container container{ key, 0U, {}, {} };
+			for (; end < std::size(values) && highBits(values[end]) == key; ++end)
+			{
+				container.array.push_back(lowBits(values[end]));
+			}
+
+			container.cardinality = static_cast<std::uint32_t>(end - begin);
+			normalize(container);
+			roaring.containers_.push_back(std::move(container));
+			begin = end;
+		}
+
+		roaring.cardinality_ = std::size(values);
+		return roaring;
+	}
+
+	std::vector<RoaringBitmap::Container>::const_iterator RoaringBitmap::findContainer(const std::uint16_t key) const noexcept
+	{
+		const auto it{ std::ranges::lower_bound(containers_, key, {}, &Container::key) };
+		return it != containers_.end() && it->key == key ? it : containers_.end();
+	}
+
+	bool RoaringBitmap::containsLow(const Container& container, const std::uint16_t low) noexcept
+	{
+		return container.isBitmap() ? testBit(container.bitmap, low) : std::ranges::binary_search(container.array, low);
+	}
+
+	bool RoaringBitmap::contains(const std::uint32_t value) const noexcept
+	{
+		const auto it{ findContainer(highBits(value)) };
+		return it != containers_.end() && containsLow(*it, lowBits(value));
+	}
+
+	std::uint32_t RoaringBitmap::maximum() const noexcept
+	{
+		const Container& container{ containers_.back() };
+		const std::uint32_t high{ static_cast<std::uint32_t>(container.key) << 16U };
+		if (!container.isBitmap())
+		{
+			return high | container.array.back();
+		}
+
+		std::size_t w{ bitmapWords - 1U };
+		while (container.bitmap[w] == 0U)
+		{
+			--w;
+		}
+		return high | static_cast<std::uint32_t>(w * 64U + 63U - static_cast<std::size_t>(std::countl_zero(container.bitmap[w])));
+	}
+
+	std::size_t RoaringBitmap::rank(const std::uint32_t value) const noexcept
+	{
+		const std::uint16_t key{ highBits(value) };
+		const std::uint16_t low{ lowBits(value) };
+
+		std::size_t rank{ 0U };
+		for (const Container& container : containers_)
+		{
+			if (container.key < key)
+			{
+				rank += container.cardinality;
+				continue;
+			}
+
+			if (container.key == key)
+			{
+				if (container.isBitmap())
+				{
+					const std::size_t word{ static_cast<std::size_t>(low >> 6U) };
+					rank += popcount(std::span{ container.bitmap }.first(word));
+					rank += static_cast<std::size_t>(std::popcount(container.bitmap[word] & ((std::uint64_t{ 1U } << (low & 63U)) - 1U)));
+				}
+				else
+				{
+					rank += static_cast<std::size_t>(std::ranges::lower_bound(container.array, low) - container.array.begin());
+				}
+			}
+
+			break;
+		}
+
+		return rank;
+	}
+
+	bool RoaringBitmap::add(const std::uint32_t value) noexcept
+	{
+		const std::uint16_t key{ highBits(value) };
+		const std::uint16_t low{ lowBits(value) };
+
+		auto it{ std::ranges::lower_bound(containers_, key, {}, &Container::key) };
+		if (it == containers_.end() || it->key != key)
+		{
+			it = containers_.insert(it, Container{ key, 0U, {}, {} });
+		}
+
+		Container& container{ *it };
+		if (container.isBitmap())
+		{
+			std::uint64_t& word{ container.bitmap[low >> 6U] };
+			const std::uint64_t bit{ std::uint64_t{ 1U } << (low & 63U) };
+			if ((word & bit) != 0U)
+			{
+				return false;
+			}
+			word |= bit;
+		}
+		else
+		{
+			const auto pos{ std::ranges::lower_bound(container.array, low) };
+			if (pos != container.array.end() && *pos == low)
+			{
+				return false;
+			}
+			container.array.insert(pos, low);
+		}
+
+		++container.cardinality;
+		++cardinality_;
+		normalize(container);
+		return true;
+	}
+
+	bool RoaringBitmap::remove(const std::uint32_t value) noexcept
+	{
+		const auto found{ findContainer(highBits(value)) };
+		if (found == containers_.end())
+		{
+			return false;
+		}
+
+		const auto it{ containers_.begin() + (found - containers_.cbegin()) };
+		Container& container{ *it };
+		const std::uint16_t low{ lowBits(value) };
+		if (container.isBitmap())
+		{
+			std::uint64_t& word{ container.bitmap[low >> 6U] };
+			const std::uint64_t bit{ std::uint64_t{ 1U } << (low & 63U) };
+			if ((word & bit) == 0U)
+			{
+				return false;
+			}
+			word &= ~bit;
+		}
+		else
+		{
+			const auto pos{ std::ranges::lower_bound(container.array, low) };
+			if (pos == container.array.end() || *pos != low)
+			{
+				return false;
+			}
+			container.array.erase(pos);
+		}
+
+		--container.cardinality;
+		--cardinality_;
+		if (container.cardinality == 0U)
+		{
+			containers_.erase(it);
+		}
+		else
+		{
+			normalize(container);
+		}
+		return true;
+	}
+
+	void RoaringBitmap::appendTo(std::vector<std::uint32_t>& values) const noexcept
+	{
+		values.reserve(std::size(values) + cardinality_);
+		for (const Container& container : containers_)
+		{
+			const std::uint32_t high{ static_cast<std::uint32_t>(container.key) << 16U };
+			if (!container.isBitmap())
+			{
+				for (const std::uint16_t low : container.array)
+				{
+					values.push_back(high | low);
+				}
+				continue;
+			}
+
+			for (std::size_t w{ 0U }; w < bitmapWords; ++w)
+			{
+				for (std::uint64_t word{ container.bitmap[w] }; word != 0U; word &= word - 1U)
+				{
+					values.push_back(high | static_cast<std::uint32_t>(w * 64U + static_cast<std::size_t>(std::countr_zero(word))));
+				}
+			}
+		}
+	}
+
+	std::size_t RoaringBitmap::Reader::read(std::vector<std::uint32_t>& values, const std::size_t count) noexcept
+	{
+		std::size_t appended{ 0U };
+		while (appended < count && container_ < std::size(bitmap_.containers_))
+		{
+			const Container& container{ bitmap_.containers_[container_] };
+			const std::uint32_t high{ static_cast<std::uint32_t>(container.key) << 16U };
+
+			if (!container.isBitmap())
+			{
+				const std::size_t n{ std::min(count - appended, std::size(container.array) - offset_) };
+				for (std::size_t i{ 0U }; i < n; ++i)
+				{
+					values.push_back(high | container.array[offset_ + i]);
+				}
+				appended += n;
+				offset_ += n;
+			}
+			else
+			{
+				while (appended < count && (word_ != 0U || offset_ < bitmapWords))
+				{
+					if (word_ == 0U)
+					{
+						word_ = container.bitmap[offset_++];
+						continue;
+					}
+
+					values.push_back(high | static_cast<std::uint32_t>((offset_ - 1U) * 64U + static_cast<std::size_t>(std::countr_zero(word_))));
+					word_ &= word_ - 1U;
+					++appended;
+				}
+			}
+
+			const bool exhausted{ container.isBitmap() ? word_ == 0U && offset_ == bitmapWords : offset_ == std::size(container.array) };
+			if (exhausted)
+			{
+				++container_;
+				offset_ = 0U;
+			}
+		}
+		return appended;
+	}
+
+	void RoaringBitmap::toBitmap(Container& container) noexcept
+	{
+		if (container.isBitmap())
+		{
+			return;
+		}
+
+		container.bitmap.assign(bitmapWords, 0U);
+		for (const std::uint16_t low : container.array)
+		{
+			container.bitmap[low >> 6U] |= std::uint64_t{ 1U } << (low & 63U);
+		}
+		container.array = {};
+	}
+
+	void RoaringBitmap::toArray(Container& container) noexcept
+	{
+		if (!container.isBitmap())
+		{
+			return;
+		}
+
+		container.array.clear();
+		container.array.reserve(container.cardinality);
+		for (std::size_t w{ 0U }; w < bitmapWords; ++w)
+		{
+			for (std::uint64_t word{ container.bitmap[w] }; word != 0U; word &= word - 1U)
+			{
+				container.array.push_back(static_cast<std::uint16_t>(w * 64U + static_cast<std::size_t>(std::countr_zero(word))));
+			}
+		}
+		container.bitmap = {};
+	}
+
+	void RoaringBitmap::normalize(Container& container) noexcept
+	{
+		if (container.cardinality > arrayMaxSize)
+		{
+			toBitmap(container);
+		}
+		else
+		{
+			toArray(container);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace RelDocFinder
+{
+	// compressed set of 32-bit values, split by their high 16 bits into chunks of up to 65536 values
+	// a sparse chunk is a sorted array of its low 16 bits, a dense one a 65536-bit bitmap
+	class RoaringBitmap
+	{
+	public:
+		// reads the values in ascending order a block at a time, straight from the chunks
+		// the bitmap must outlive the reader and not change meanwhile
+		class Reader
+		{
+		public:
+			explicit Reader(const RoaringBitmap& bitmap) noexcept : bitmap_{ bitmap } {}
+
+			// appends up to count of the next values, returns #(values appended), 0 once every value was read
+			std::size_t read(std::vector<std::uint32_t>& values, const std::size_t count) noexcept;
+
+		private:
+			const RoaringBitmap& bitmap_;
+			std::size_t container_{ 0U };
+			std::size_t offset_{ 0U };				// into a sparse chunk's array, or past the dense chunk's word being read
+			std::uint64_t word_{ 0U };				// the bits of that word not read yet
+		};
+
+		RoaringBitmap() noexcept = default;
+
+		// values must be ascending
+		[[nodiscard]] static RoaringBitmap fromSorted(std::span<const std::uint32_t> values) noexcept;
+
+		[[nodiscard]] std::size_t cardinality() const noexcept { return cardinality_; }
+
+		[[nodiscard]] bool empty() const noexcept { return cardinality_ == 0U; }
+
+		[[nodiscard]] bool contains(const std::uint32_t value) const noexcept;
+
+		// the largest value, the bitmap must not be empty
+		[[nodiscard]] std::uint32_t maximum() const noexcept;
+
+		// #(values less than value)
+		[[nodiscard]] std::size_t rank(const std::uint32_t value) const noexcept;
+
+		bool add(const std::uint32_t value) noexcept;
+
+		bool remove(const std::uint32_t value) noexcept;
+
+		// appends the values in ascending order
+		void appendTo(std::vector<std::uint32_t>& values) const noexcept;
+
+	private:
+		struct Container
+		{
+			std::uint16_t key;						// the high 16 bits of the chunk's values
+			std::uint32_t cardinality;
+			std::vector<std::uint16_t> array;		// sorted low 16 bits, while the chunk is sparse
+			std::vector<std::uint64_t> bitmap;		// 1024 words, once the chunk is dense
+
+			[[nodiscard]] bool isBitmap() const noexcept { return !bitmap.empty(); }
+		};
+
+		// beyond this many values a bitmap is smaller than an array
+		static constexpr std::size_t arrayMaxSize{ 4096U };
+		static constexpr std::size_t bitmapWords{ 65536U / 64U };
+
+
+		std::vector<Container> containers_;			// ascending by key
+		std::size_t cardinality_{ 0U };
+
+
+		[[nodiscard]] std::vector<Container>::const_iterator findContainer(const std::uint16_t key) const noexcept;
+
+		static void toBitmap(Container& container) noexcept;
+
+		static void toArray(Container& container) noexcept;
+
+		// picks the smaller representation for the container's cardinality
+		static void normalize(Container& container) noexcept;
+
+		static bool containsLow(const Container& container, const std::uint16_t low) noexcept;
+	};
+}
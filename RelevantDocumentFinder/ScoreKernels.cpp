@@ -0,0 +1,220 @@
+#include "ScoreKernels.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+namespace RelDocFinder::ScoreKernels
+{
+	namespace
+	{
+		// bounded heap of the n best candidates, the worst of them at the front
+		class TopN
+		{
+		public:
+			TopN(std::span<const DocId> tieKeys, const std::size_t n) : better_{ tieKeys }, n_{ n }
+			{
+				heap_.reserve(n);
+			}
+
+			// candidates scoring below the threshold can never enter the heap
+			[[nodiscard]] double threshold() const noexcept
+			{
+				return heap_.size() < n_ ? -std::numeric_limits<double>::infinity() : heap_.front().score;
+			}
+
+			void offer(const DocOrdinal ordinal, const double score) noexcept
+			{
+				const ScoredOrdinal candidate{ ordinal, score };
+				if (heap_.size() < n_)
+				{
+					heap_.push_back(candidate);
+					std::push_heap(heap_.begin(), heap_.end(), better_);
+				}
+				else if (n_ != 0U && better_(candidate, heap_.front()))
+				{
+					std::pop_heap(heap_.begin(), heap_.end(), better_);
+					heap_.back() = candidate;
+					std::push_heap(heap_.begin(), heap_.end(), better_);
+				}
+			}
+
+			[[nodiscard]] std::vector<ScoredOrdinal> take() noexcept
+			{
+				std::sort_heap(heap_.begin(), heap_.end(), better_);
+				return std::move(heap_);
+			}
+
+		private:
+			struct Better
+			{
+				std::span<const DocId> tieKeys;
+
+				bool operator()(const ScoredOrdinal lhs, const ScoredOrdinal rhs) const noexcept
+				{
+					if (lhs.score != rhs.score)
+					{
+						return lhs.score > rhs.score;
+					}
+					return tieKeys[lhs.ordinal] < tieKeys[rhs.ordinal];
+				}
+			};
+
+			Better better_;
+			std::size_t n_;
+			std::vector<ScoredOrdinal> heap_;
+		};
+
+		[[nodiscard]] bool isLive(std::span<const std::uint64_t> liveOrdinals, const std::size_t ordinal) noexcept
+		{
+			return (liveOrdinals[ordinal >> 6U] >> (ordinal & 63U)) & 1U;
+		}
+	}
+
+	void accumulate(std::span<double> accumulators, std::span<const DocOrdinal> ordinals,
+		std::span<const std::uint32_t> frequencies, const double weight) noexcept
+	{
+		double* acc{ accumulators.data() };
+		const std::size_t count{ ordinals.size() };
+		std::size_t i{ 0U };
+
+#if defined(__AVX512F__)
+		const __m512d vWeight{ _mm512_set1_pd(weight) };
+		for (; i + 8U <= count; i += 8U)
+		{
+			const __m256i vOrdinals{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ordinals.data() + i)) };
+			const __m256i vFrequencies{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(frequencies.data() + i)) };
+			const __m512d vAcc{ _mm512_i32gather_pd(vOrdinals, acc, 8) };
+			_mm512_i32scatter_pd(acc, vOrdinals, _mm512_fmadd_pd(_mm512_cvtepu32_pd(vFrequencies), vWeight, vAcc), 8);
+		}
+#elif defined(__AVX2__)
+		// AVX2 can gather but not scatter, so the four sums are written back one by one
+		const __m256d vWeight{ _mm256_set1_pd(weight) };
+		alignas(32) double sums[4];
+		for (; i + 4U <= count; i += 4U)
+		{
+			const __m128i vOrdinals{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(ordinals.data() + i)) };
+			const __m128i vFrequencies{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(frequencies.data() + i)) };
+			const __m256d vAcc{ _mm256_i32gather_pd(acc, vOrdinals, 8) };
+			_mm256_store_pd(sums, _mm256_add_pd(vAcc, _mm256_mul_pd(_mm256_cvtepi32_pd(vFrequencies), vWeight)));
+			acc[ordinals[i]] = sums[0];
+			acc[ordinals[i + 1U]] = sums[1];
+			acc[ordinals[i + 2U]] = sums[2];
+			acc[ordinals[i + 3U]] = sums[3];
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			acc[ordinals[i]] += frequencies[i] * weight;
+		}
+	}
+
+	void accumulate(std::span<double> accumulators, std::span<const DocOrdinal> ordinals,
+		std::span<const std::uint32_t> frequencies, const double weight, std::span<const double> norms) noexcept
+	{
+		for (std::size_t i{ 0U }; i < std::size(ordinals); ++i)
+		{
+			accumulators[ordinals[i]] += frequencies[i] * weight * norms[ordinals[i]];
+		}
+	}
+
+	std::vector<ScoredOrdinal> selectTopN(std::span<const double> accumulators, std::span<const double> scales,
+		std::span<const std::uint64_t> liveOrdinals, std::span<const DocId> tieKeys, const std::size_t n) noexcept
+	{
+		TopN topN{ tieKeys, n };
+		if (n == 0U)
+		{
+			return topN.take();
+		}
+
+		const std::size_t count{ accumulators.size() };
+		std::size_t i{ 0U };
+
+#if defined(__AVX512F__)
+		alignas(64) double lanes[8];
+		for (; i + 8U <= count; i += 8U)
+		{
+			const auto live{ static_cast<__mmask8>(liveOrdinals[i >> 6U] >> (i & 63U)) };
+			if (live == 0U)
+			{
+				continue;
+			}
+
+			const __m512d vScores{ _mm512_mul_pd(_mm512_loadu_pd(accumulators.data() + i), _mm512_loadu_pd(scales.data() + i)) };
+			unsigned candidates{ _mm512_mask_cmp_pd_mask(live, vScores, _mm512_set1_pd(topN.threshold()), _CMP_GE_OQ) };
+			if (candidates == 0U)
+			{
+				continue;
+			}
+
+			_mm512_store_pd(lanes, vScores);
+			for (; candidates != 0U; candidates &= candidates - 1U)
+			{
+				const auto lane{ std::countr_zero(candidates) };
+				topN.offer(static_cast<DocOrdinal>(i + lane), lanes[lane]);
+			}
+		}
+#elif defined(__AVX2__)
+		alignas(32) double lanes[4];
+		for (; i + 4U <= count; i += 4U)
+		{
+			const auto live{ static_cast<unsigned>(liveOrdinals[i >> 6U] >> (i & 63U)) & 0xFU };
+			if (live == 0U)
+			{
+				continue;
+			}
+
+			const __m256d vScores{ _mm256_mul_pd(_mm256_loadu_pd(accumulators.data() + i), _mm256_loadu_pd(scales.data() + i)) };
+			const __m256d vThreshold{ _mm256_set1_pd(topN.threshold()) };
+			unsigned candidates{ live & static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(vScores, vThreshold, _CMP_GE_OQ))) };
+			if (candidates == 0U)
+			{
+				continue;
+			}
+
+			_mm256_store_pd(lanes, vScores);
+			for (; candidates != 0U; candidates &= candidates - 1U)
+			{
+				const auto lane{ std::countr_zero(candidates) };
+				topN.offer(static_cast<DocOrdinal>(i + lane), lanes[lane]);
+			}
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			if (isLive(liveOrdinals, i))
+			{
+				const double score{ accumulators[i] * scales[i] };
+				if (score >= topN.threshold())
+				{
+					topN.offer(static_cast<DocOrdinal>(i), score);
+				}
+			}
+		}
+
+		return topN.take();
+	}
+
+	std::vector<ScoredOrdinal> selectTopCandidates(std::span<const double> accumulators, std::span<const DocOrdinal> candidates,
+		std::span<const double> scales, std::span<const DocId> tieKeys, const std::size_t n) noexcept
+	{
+		TopN topN{ tieKeys, n };
+		for (std::size_t i{ 0U }; n != 0U && i < candidates.size(); ++i)
+		{
+			const double score{ accumulators[i] * scales[candidates[i]] };
+			if (score >= topN.threshold())
+			{
+				topN.offer(candidates[i], score);
+			}
+		}
+
+		return topN.take();
+	}
+}
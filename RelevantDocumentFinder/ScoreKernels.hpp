@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CorpusTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace RelDocFinder::ScoreKernels
+{
+	struct ScoredOrdinal
+	{
+		DocOrdinal ordinal;
+		double score;
+	};
+
+	// accumulators[ordinals[i]] += frequencies[i] * weight
+	// ordinals of a single posting list are unique, so the scattered writes never conflict
+	void accumulate(std::span<double> accumulators, std::span<const DocOrdinal> ordinals,
+		std::span<const std::uint32_t> frequencies, const double weight) noexcept;
+
+	// accumulators[ordinals[i]] += frequencies[i] * weight * norms[ordinals[i]]
+	// for the postings of a field, whose norms rescale the document length to the field length
+	void accumulate(std::span<double> accumulators, std::span<const DocOrdinal> ordinals,
+		std::span<const std::uint32_t> frequencies, const double weight, std::span<const double> norms) noexcept;
+
+	// scans score(i) = accumulators[i] * scales[i] over every ordinal set in liveOrdinals
+	// and returns the n best, highest score first, ties broken by the lower tieKeys[i]
+	[[nodiscard]] std::vector<ScoredOrdinal> selectTopN(std::span<const double> accumulators, std::span<const double> scales,
+		std::span<const std::uint64_t> liveOrdinals, std::span<const DocId> tieKeys, const std::size_t n) noexcept;
+
+	// like selectTopN, over the candidates only, accumulators[i] belonging to candidates[i]
+	[[nodiscard]] std::vector<ScoredOrdinal> selectTopCandidates(std::span<const double> accumulators, std::span<const DocOrdinal> candidates,
+		std::span<const double> scales, std::span<const DocId> tieKeys, const std::size_t n) noexcept;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace RelDocFinder::Varint
+{
+	// little endian base 128, 7 bits a byte, the high bit set on every byte but the last
+	inline void put(std::vector<std::uint8_t>& out, std::uint32_t value) noexcept
+	{
+		while (value >= 0x80U)
+		{
+			out.push_back(static_cast<std::uint8_t>(value | 0x80U));
+			value >>= 7U;
+		}
+		out.push_back(static_cast<std::uint8_t>(value));
+	}
+
+	inline std::uint32_t get(const std::uint8_t*& in) noexcept
+	{
+		std::uint32_t value{ 0U };
+		for (unsigned shift{ 0U }; ; shift += 7U)
+		{
+			const std::uint8_t byte{ *in++ };
+			value |= static_cast<std::uint32_t>(byte & 0x7FU) << shift;
+			if (byte < 0x80U)
+			{
+				return value;
+			}
+		}
+	}
+}